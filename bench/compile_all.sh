@@ -0,0 +1,8 @@
+#!/bin/bash
+gcc -o bin/echoBench.o echoBench.c -static -l:libcsocket.a -lpthread -L../bin -I../bin
+gcc -o bin/kaBench.o kaBench.c -static -l:libcsocket.a -L../bin -I../bin
+gcc -o bin/loadGen.o loadGen.c -static -l:libcsocket.a -lpthread -L../bin -I../bin
+# scaleBench counts the syscalls of the library through wrappers
+gcc -o bin/scaleBench.o scaleBench.c -static -l:libcsocket.a -L../bin -I../bin -Wl,--wrap=poll,--wrap=accept,--wrap=recv,--wrap=recvfrom,--wrap=send,--wrap=sendto,--wrap=sendmsg,--wrap=setsockopt,--wrap=getsockopt,--wrap=shutdown,--wrap=close,--wrap=fcntl
+
+strip -s bin/*.o
@@ -0,0 +1,267 @@
+/**
+ * @file echoBench.c
+ * @author Felix Kröhnert (felix.kroehnert@online.de)
+ * @brief loopback echo benchmark for the multiServer
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Starts a multiServer echo server in a child process and drives it over loopback with
+ * closed-loop clients (one thread each). The server reports its counters (csocket_getStats) back
+ * over the pipe it signals readiness on. Prints the result as one JSON line (the only line
+ * starting with '{').
+ *
+ * usage: echoBench [-c clients] [-s size] [-n messages per client] [-k] [-p port]
+ *
+**/
+
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "csocket.h"
+
+
+struct bench_config {
+	int clients;
+	size_t size;
+	long messages;
+	int keepalive;
+	int port;
+};
+
+struct bench_client {
+	pthread_t thread;
+	const struct bench_config *config;
+	// round trip times in ns
+	long long *rtt;
+	long done;
+	int failed;
+};
+
+
+/*
+	SERVER
+*/
+
+static volatile sig_atomic_t running = 1;
+
+static void onTerm(int signum) {
+	(void)signum;
+	running = 0;
+}
+
+static void onEcho(csocket_multiHandler_t *handler, csocket_activity_t *activity) {
+	(void)handler;
+	if(!(activity->type&CSACT_TYPE_READ)) return;
+
+	char buf[65536];
+	ssize_t len = csocket_recvA(activity, buf, sizeof buf, 0);
+	if(len<=0) {
+		activity->client_socket.shutdown = 1;
+		return;
+	}
+	for(ssize_t sent = 0, res; sent<len; sent += res) {
+		res = csocket_sendA(activity, buf+sent, len-sent, 0);
+		if(res<=0) {
+			activity->client_socket.shutdown = 1;
+			return;
+		}
+	}
+}
+
+static int runServer(const struct bench_config *config, int ready) {
+	csocket_t socket = CSOCKET_EMPTY;
+	csocket_multiHandler_t handler = CSOCKET_EMPTY;
+	csocket_keepalive_t ka = CSOCKET_EMPTY;
+
+	signal(SIGTERM, onTerm);
+
+	if(csocket_initServerSocket(AF_INET, SOCK_STREAM, 0, (void*)&inaddr_any, config->port, &socket, 1)) return 1;
+	if(config->keepalive) {
+		if(csocket_keepalive_create(0, NULL, 0, &ka, &socket)) return 1;
+		csocket_keepalive_set(&ka, &socket);
+	}
+	if(csocket_bindServer(&socket) || csocket_listen(&socket, config->clients)) return 1;
+	if(csocket_setUpMultiServer2(&socket, config->clients, onEcho, NULL, &handler)) return 1;
+
+	// signal the parent
+	if(write(ready, "r", 1)!=1) return 1;
+
+	while(running) {
+		// sleep in poll on the set of the last iteration instead of spinning, so CPU time is per message
+		poll(handler.pfds, handler.maxClients+1, 1);
+		if(csocket_multiServer(&handler)) break;
+	}
+
+	// counters of all clients
+	csocket_stats_t stats;
+	if(!csocket_getStats(&handler, NULL, &stats) && write(ready, &stats, sizeof stats)!=sizeof stats) return 1;
+	close(ready);
+
+	csocket_close(&socket);
+	csocket_freeMultiHandler(&handler);
+	return 0;
+}
+
+
+/*
+	CLIENTS
+*/
+
+static long long nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+
+static void * runClient(void *arg) {
+	struct bench_client *client = arg;
+	const struct bench_config *config = client->config;
+
+	csocket_t socket = CSOCKET_EMPTY;
+	csocket_keepalive_t ka = CSOCKET_EMPTY;
+	struct timeval timeout = {5, 0};
+	char *msg = malloc(config->size), *buf = malloc(config->size);
+
+	client->failed = 1;
+	if(!msg || !buf) goto end;
+	memset(msg, 'x', config->size);
+
+	if(csocket_initClientSocket(AF_INET, SOCK_STREAM, 0, "127.0.0.1", config->port, &socket, 0)) goto end;
+	if(config->keepalive) {
+		if(csocket_keepalive_create(0, NULL, 0, &ka, &socket)) goto end;
+		csocket_keepalive_set(&ka, &socket);
+	}
+	if(csocket_connectClient(&socket, &timeout)) goto end;
+
+	for(long i=0; i<config->messages; ++i) {
+		if(config->keepalive)
+			csocket_keepAlive(&socket);
+
+		long long start = nowNs();
+		if(csocket_send(&socket, msg, config->size, 0)!=(ssize_t)config->size) goto end;
+		for(size_t got = 0; got<config->size;) {
+			ssize_t res = csocket_recv(&socket, buf+got, config->size-got, 0);
+			if(res<=0) goto end;
+			got += res;
+		}
+		client->rtt[i] = nowNs()-start;
+		client->done = i+1;
+	}
+	client->failed = 0;
+
+end:
+	{
+		// csocket_close only shuts the connection down
+		int fd = socket.mode.fd;
+		csocket_close(&socket);
+		if(fd>0)
+			close(fd);
+	}
+	free(msg);
+	free(buf);
+	return NULL;
+}
+
+static int compareLL(const void *a, const void *b) {
+	long long x = *(const long long*)a, y = *(const long long*)b;
+	return (x>y)-(x<y);
+}
+
+static double percentileUs(const long long *sorted, long count, double p) {
+	if(count<=0) return 0;
+	long index = (long)(p*(count-1)+0.5);
+	return sorted[index]/1000.0;
+}
+
+
+int main(int argc, char **argv) {
+
+	struct bench_config config = {.clients = 1, .size = 64, .messages = 10000, .keepalive = 0, .port = 4250};
+
+	for(int i=1; i<argc; ++i) {
+		if(strcmp(argv[i], "-k")==0) config.keepalive = 1;
+		else if(i+1<argc && strcmp(argv[i], "-c")==0) config.clients = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-s")==0) config.size = strtoul(argv[++i], NULL, 10);
+		else if(i+1<argc && strcmp(argv[i], "-n")==0) config.messages = atol(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-p")==0) config.port = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-c clients] [-s size] [-n messages per client] [-k] [-p port]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(config.clients<1 || config.size<1 || config.size>65536 || config.messages<1) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+
+	// server
+	int pipefd[2];
+	if(pipe(pipefd)) return 1;
+	pid_t server = fork();
+	if(server<0) return 1;
+	if(server==0) {
+		close(pipefd[0]);
+		_exit(runServer(&config, pipefd[1]));
+	}
+	close(pipefd[1]);
+	char ready;
+	if(read(pipefd[0], &ready, 1)!=1) {
+		fprintf(stderr, "server failed\n");
+		waitpid(server, NULL, 0);
+		return 1;
+	}
+
+	// clients
+	struct bench_client *clients = calloc(config.clients, sizeof(struct bench_client));
+	long long *rtt = calloc((size_t)config.clients*config.messages, sizeof(long long));
+	if(!clients || !rtt) return 1;
+
+	long long start = nowNs();
+	for(int i=0; i<config.clients; ++i) {
+		clients[i].config = &config;
+		clients[i].rtt = rtt+(size_t)i*config.messages;
+		pthread_create(&clients[i].thread, NULL, runClient, &clients[i]);
+	}
+	long total = 0;
+	int failed = 0;
+	for(int i=0; i<config.clients; ++i) {
+		pthread_join(clients[i].thread, NULL);
+		failed += clients[i].failed;
+	}
+	double secs = (nowNs()-start)/1e9;
+
+	// server CPU time
+	kill(server, SIGTERM);
+	struct rusage usage = {0};
+	wait4(server, NULL, 0, &usage);
+	double cpu = usage.ru_utime.tv_sec+usage.ru_stime.tv_sec+(usage.ru_utime.tv_usec+usage.ru_stime.tv_usec)/1e6;
+	csocket_stats_t stats = CSOCKET_EMPTY;
+	if(read(pipefd[0], &stats, sizeof stats)!=sizeof stats)
+		fprintf(stderr, "no server counters\n");
+	close(pipefd[0]);
+
+	// compact the samples of all clients
+	for(int i=0; i<config.clients; ++i) {
+		memmove(rtt+total, clients[i].rtt, clients[i].done*sizeof(long long));
+		total += clients[i].done;
+	}
+	qsort(rtt, total, sizeof(long long), compareLL);
+
+	printf("{\"bench\":\"echo\",\"clients\":%d,\"size\":%zu,\"keepalive\":%d,\"failed\":%d,\"msgs\":%ld,\"secs\":%.6f,"
+		"\"msgs_per_s\":%.1f,\"mb_per_s\":%.3f,\"server_cpu_us_per_msg\":%.3f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,"
+		"\"server_recv_per_msg\":%.2f,\"server_send_per_msg\":%.2f,\"server_eagain\":%llu}\n",
+		config.clients, config.size, config.keepalive, failed, total, secs,
+		total/secs, total*(double)config.size/secs/1e6, total?cpu*1e6/total:0,
+		percentileUs(rtt, total, 0.5), percentileUs(rtt, total, 0.99), percentileUs(rtt, total, 0.999),
+		total?(double)stats.recv_calls/total:0, total?(double)stats.send_calls/total:0, stats.eagain);
+
+	free(clients);
+	free(rtt);
+	return failed?1:0;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file loadGen.c
+ * @author Felix Kröhnert (felix.kroehnert@online.de)
+ * @brief open-loop load generator for echo servers
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Holds a target request rate across many connections, independent of how fast the server
+ * answers. Every request has an intended send time from the schedule. Latency is measured from
+ * it, so requests delayed by a slow server are counted (coordinated omission). The latency
+ * from the actual send is recorded as well. The server has to echo every message, with the
+ * same keepalive settings if -k is used. UDP messages carry a sequence number, lost ones are
+ * counted after the loss timeout. Latencies are recorded in csocket_histogram_t. Prints the
+ * result as one JSON line (the only line starting with '{').
+ *
+ * usage: loadGen [-h host] [-p port] [-c connections] [-t threads] [-r rate] [-d seconds]
+ *                [-s size] [-u] [-k keepalive timeout] [-l loss timeout ms]
+ *
+**/
+
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "csocket.h"
+
+
+// outstanding requests per connection
+#define WINDOW 1024
+
+struct bench_config {
+	char *host;
+	int port;
+	int connections;
+	int threads;
+	double rate;
+	double duration;
+	size_t size;
+	int udp;
+	int keepalive;
+	long loss_ms;
+};
+
+struct connection {
+	csocket_t socket;
+	csocket_keepalive_t ka;
+	// next intended send time
+	long long next;
+	// outstanding requests: head is the oldest, tail the next sequence number
+	unsigned long head, tail;
+	long long intended[WINDOW];
+	long long sent[WINDOW];
+	char done[WINDOW];
+	// stream: bytes of queued requests not yet sent, bytes of the current response received
+	size_t pending, received;
+};
+
+struct bench_thread {
+	pthread_t thread;
+	const struct bench_config *config;
+	struct connection *conns;
+	int count;
+	long long end;
+	// latencies in ns
+	csocket_histogram_t corrected, uncorrected;
+	unsigned long requests, responses, lost, errors;
+};
+
+
+/*
+	LOAD
+*/
+
+static long long nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+
+static double percentileUs(const csocket_histogram_t *hist, double p) {
+	return csocket_histogram_percentile(hist, p)/1e3;
+}
+
+static void complete(struct bench_thread *thread, struct connection *conn, unsigned long seq, long long now) {
+	if(seq<conn->head || seq>=conn->tail || conn->done[seq%WINDOW]) return;
+	conn->done[seq%WINDOW] = 1;
+	csocket_histogram_record(&thread->corrected, now-conn->intended[seq%WINDOW]);
+	csocket_histogram_record(&thread->uncorrected, now-conn->sent[seq%WINDOW]);
+	++thread->responses;
+	while(conn->head<conn->tail && conn->done[conn->head%WINDOW])
+		++conn->head;
+}
+
+// queue and send the requests that are due
+static int sendDue(struct bench_thread *thread, struct connection *conn, char *msg, long long now, long long interval) {
+	const struct bench_config *config = thread->config;
+
+	while(conn->next<=now && conn->next<thread->end && conn->tail-conn->head<WINDOW) {
+		unsigned long seq = conn->tail++;
+		conn->intended[seq%WINDOW] = conn->next;
+		conn->sent[seq%WINDOW] = now;
+		conn->done[seq%WINDOW] = 0;
+		conn->next += interval;
+		++thread->requests;
+
+		if(config->udp) {
+			memcpy(msg, &seq, sizeof seq);
+			if(csocket_send(&conn->socket, msg, config->size, MSG_DONTWAIT)!=(ssize_t)config->size)
+				++thread->errors;
+		}
+		else
+			conn->pending += config->size;
+	}
+
+	// stream: the payload is constant, only the amount is tracked
+	while(conn->pending>0) {
+		size_t len = conn->pending<65536?conn->pending:65536;
+		ssize_t res = csocket_send(&conn->socket, msg, len, MSG_DONTWAIT);
+		if(res<=0) {
+			if(errno==EAGAIN || errno==EWOULDBLOCK) break;
+			return -1;
+		}
+		conn->pending -= res;
+	}
+	return 0;
+}
+
+static int receive(struct bench_thread *thread, struct connection *conn, char *buf) {
+	const struct bench_config *config = thread->config;
+
+	for(;;) {
+		ssize_t res = csocket_recv(&conn->socket, buf, config->udp?config->size:65536, MSG_DONTWAIT);
+		// buffered keepalive reads return 0 if nothing but keepalives arrived
+		if(res==0 && !config->udp && !config->keepalive) return -1;
+		if(res<=0) return 0;
+		long long now = nowNs();
+
+		if(config->udp) {
+			unsigned long seq;
+			if((size_t)res<sizeof seq) continue;
+			memcpy(&seq, buf, sizeof seq);
+			complete(thread, conn, seq, now);
+			continue;
+		}
+
+		// stream: responses arrive in order
+		conn->received += res;
+		while(conn->received>=config->size) {
+			conn->received -= config->size;
+			complete(thread, conn, conn->head, now);
+		}
+	}
+}
+
+static void * runThread(void *arg) {
+	struct bench_thread *thread = arg;
+	const struct bench_config *config = thread->config;
+	// per connection
+	long long interval = (long long)(1e9*config->connections/config->rate);
+	long long loss = config->loss_ms*1000000LL;
+
+	char *msg = calloc(1, config->size<65536?65536:config->size), *buf = malloc(65536);
+	struct pollfd *pfds = calloc(thread->count, sizeof(struct pollfd));
+	if(!msg || !buf || !pfds) {
+		thread->errors += thread->count;
+		goto end;
+	}
+	memset(msg, 'x', 65536);
+
+	for(;;) {
+		long long now = nowNs();
+
+		int open = 0;
+		long long wake = now+100000000LL;
+		for(int i=0; i<thread->count; ++i) {
+			struct connection *conn = &thread->conns[i];
+			pfds[i].fd = -1;
+			pfds[i].revents = 0;
+			if(conn->socket.mode.fd<=0) continue;
+
+			if(config->keepalive)
+				csocket_keepAlive(&conn->socket);
+			if(sendDue(thread, conn, msg, now, interval) || receive(thread, conn, buf)) {
+				++thread->errors;
+				// csocket_close only shuts the connection down and empties the socket
+				int fd = conn->socket.mode.fd;
+				csocket_close(&conn->socket);
+				close(fd);
+				conn->socket.mode.fd = -1;
+				continue;
+			}
+
+			// udp: give up on requests older than the loss timeout
+			while(config->udp && conn->head<conn->tail && now-conn->sent[conn->head%WINDOW]>loss) {
+				if(!conn->done[conn->head%WINDOW]) ++thread->lost;
+				++conn->head;
+			}
+
+			if(conn->next<thread->end || conn->head<conn->tail) ++open;
+			pfds[i].fd = conn->socket.mode.fd;
+			pfds[i].events = POLLIN|(conn->pending?POLLOUT:0);
+			if(conn->next<wake && conn->next<thread->end && conn->tail-conn->head<WINDOW) wake = conn->next;
+		}
+
+		// done sending and nothing outstanding, or the drain period is over
+		if(!open || now>thread->end+loss) break;
+
+		// poll has ms resolution, spin for the last one so requests leave on schedule
+		long long wait = wake-nowNs();
+		poll(pfds, thread->count, wait>1000000?(int)(wait/1000000):0);
+	}
+
+	// outstanding at the end
+	for(int i=0; i<thread->count; ++i) {
+		struct connection *conn = &thread->conns[i];
+		for(unsigned long seq = conn->head; seq<conn->tail; ++seq)
+			if(!conn->done[seq%WINDOW]) ++thread->lost;
+	}
+
+end:
+	free(msg);
+	free(buf);
+	free(pfds);
+	return NULL;
+}
+
+static int openConnection(const struct bench_config *config, struct connection *conn, long long next) {
+	struct timeval timeout = {5, 0};
+
+	conn->socket = (const csocket_t)CSOCKET_EMPTY;
+	conn->ka = (const csocket_keepalive_t)CSOCKET_EMPTY;
+	conn->next = next;
+
+	if(csocket_initClientSocket(AF_INET, config->udp?SOCK_DGRAM:SOCK_STREAM, 0, config->host, config->port, &conn->socket, 0)) return -1;
+	if(config->keepalive) {
+		if(csocket_keepalive_create(config->keepalive, NULL, 0, &conn->ka, &conn->socket)) return -1;
+		csocket_keepalive_set(&conn->ka, &conn->socket);
+	}
+	if(csocket_connectClient(&conn->socket, &timeout)) {
+		fprintf(stderr, "connect failed: %s\n", csocket_strerror(conn->socket.err));
+		return -1;
+	}
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+	struct bench_config config = {.host = "127.0.0.1", .port = 4250, .connections = 16, .threads = 1,
+		.rate = 10000, .duration = 10, .size = 64, .udp = 0, .keepalive = 0, .loss_ms = 1000};
+
+	for(int i=1; i<argc; ++i) {
+		if(strcmp(argv[i], "-u")==0) config.udp = 1;
+		else if(i+1<argc && strcmp(argv[i], "-h")==0) config.host = argv[++i];
+		else if(i+1<argc && strcmp(argv[i], "-p")==0) config.port = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-c")==0) config.connections = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-t")==0) config.threads = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-r")==0) config.rate = atof(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-d")==0) config.duration = atof(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-s")==0) config.size = strtoul(argv[++i], NULL, 10);
+		else if(i+1<argc && strcmp(argv[i], "-k")==0) config.keepalive = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-l")==0) config.loss_ms = atol(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] [-t threads] [-r rate] [-d seconds]\n"
+				"\t[-s size] [-u] [-k keepalive timeout] [-l loss timeout ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(config.connections<1 || config.threads<1 || config.rate<=0 || config.duration<=0 || config.keepalive<0
+		|| config.size<(config.udp?sizeof(unsigned long):1) || config.size>65536 || config.loss_ms<1) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+	if(config.threads>config.connections) config.threads = config.connections;
+
+	// closed connections count as errors
+	signal(SIGPIPE, SIG_IGN);
+
+	struct connection *conns = calloc(config.connections, sizeof(struct connection));
+	struct bench_thread *threads = calloc(config.threads, sizeof(struct bench_thread));
+	if(!conns || !threads) return 1;
+
+	// connections start staggered over one interval
+	long long interval = (long long)(1e9*config.connections/config.rate);
+	long long start = nowNs()+100000000LL;
+	for(int i=0; i<config.connections; ++i) {
+		if(openConnection(&config, &conns[i], start+interval*i/config.connections)) return 1;
+	}
+	long long end = start+(long long)(config.duration*1e9);
+
+	// contiguous share of the connections per thread
+	for(int i=0, first=0; i<config.threads; ++i) {
+		threads[i].config = &config;
+		threads[i].conns = conns+first;
+		threads[i].count = config.connections/config.threads+(i<config.connections%config.threads);
+		threads[i].end = end;
+		first += threads[i].count;
+		pthread_create(&threads[i].thread, NULL, runThread, &threads[i]);
+	}
+
+	csocket_histogram_t *corrected = calloc(1, sizeof(csocket_histogram_t)), *uncorrected = calloc(1, sizeof(csocket_histogram_t));
+	if(!corrected || !uncorrected) return 1;
+	unsigned long requests = 0, responses = 0, lost = 0, errors = 0;
+	for(int i=0; i<config.threads; ++i) {
+		pthread_join(threads[i].thread, NULL);
+		csocket_histogram_merge(corrected, &threads[i].corrected);
+		csocket_histogram_merge(uncorrected, &threads[i].uncorrected);
+		requests += threads[i].requests;
+		responses += threads[i].responses;
+		lost += threads[i].lost;
+		errors += threads[i].errors;
+	}
+
+	printf("{\"bench\":\"load\",\"mode\":\"%s\",\"connections\":%d,\"threads\":%d,\"size\":%zu,\"keepalive\":%d,\"rate\":%.1f,\"secs\":%.3f,"
+		"\"requests\":%lu,\"responses\":%lu,\"lost\":%lu,\"errors\":%lu,\"achieved_rate\":%.1f,"
+		"\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,"
+		"\"uncorrected_p50_us\":%.1f,\"uncorrected_p99_us\":%.1f,\"uncorrected_p999_us\":%.1f}\n",
+		config.udp?"udp":"tcp", config.connections, config.threads, config.size, config.keepalive, config.rate, config.duration,
+		requests, responses, lost, errors, responses/config.duration,
+		percentileUs(corrected, 0.5), percentileUs(corrected, 0.9), percentileUs(corrected, 0.99), percentileUs(corrected, 0.999), corrected->max/1e3,
+		percentileUs(uncorrected, 0.5), percentileUs(uncorrected, 0.99), percentileUs(uncorrected, 0.999));
+
+	for(int i=0; i<config.connections; ++i) {
+		if(conns[i].socket.mode.fd>0) {
+			// csocket_close only shuts the connection down
+			int fd = conns[i].socket.mode.fd;
+			csocket_close(&conns[i].socket);
+			close(fd);
+		}
+		if(config.keepalive)
+			csocket_freeKeepalive(&conns[i].ka);
+	}
+	free(conns);
+	free(threads);
+	free(corrected);
+	free(uncorrected);
+	return errors?1:0;
+}
@@ -0,0 +1,396 @@
+/**
+ * @file scaleBench.c
+ * @author Felix Kröhnert (felix.kroehnert@online.de)
+ * @brief connection-scaling benchmark for the multiServer
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Starts a multiServer echo server in a child process, opens a set of mostly idle loopback
+ * connections and lets a small active subset exchange messages. The server records the time
+ * of each csocket_multiServer iteration, the syscalls issued by the library per iteration and
+ * its RSS per connection. Syscalls are counted with wrappers, the binary has to be linked with
+ * the --wrap options of compile_all.sh. Prints one JSON line per connection count (the only
+ * lines starting with '{').
+ *
+ * usage: scaleBench [-c connections]... [-a active] [-i iterations] [-s size] [-k] [-p port]
+ *
+**/
+
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "csocket.h"
+
+
+// connects in flight before waiting for the server to accept
+#define CONNECT_WINDOW 256
+// connections per loopback source address, stays below the ephemeral port range
+#define CONNS_PER_ADDR 20000
+#define MAX_COUNTS 8
+
+struct bench_config {
+	long connections;
+	int active;
+	long iterations;
+	size_t size;
+	int keepalive;
+	int port;
+};
+
+// shared between the server and the clients
+struct bench_shared {
+	volatile long accepted;
+	volatile int active;
+	volatile int measured;
+	long rss_base;
+	long rss_full;
+	unsigned long syscalls;
+	// ns per iteration, config.iterations entries
+	long long iter_ns[];
+};
+
+
+/*
+	SYSCALL COUNTER
+*/
+
+static unsigned long syscalls = 0;
+
+#define WRAP(ret, name, params, args) \
+	ret __real_##name params; \
+	ret __wrap_##name params { ++syscalls; return __real_##name args; }
+
+WRAP(int, poll, (struct pollfd *fds, nfds_t nfds, int timeout), (fds, nfds, timeout))
+WRAP(int, accept, (int fd, struct sockaddr *addr, socklen_t *addr_len), (fd, addr, addr_len))
+WRAP(ssize_t, recv, (int fd, void *buf, size_t len, int flags), (fd, buf, len, flags))
+WRAP(ssize_t, recvfrom, (int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addr_len), (fd, buf, len, flags, addr, addr_len))
+WRAP(ssize_t, send, (int fd, const void *buf, size_t len, int flags), (fd, buf, len, flags))
+WRAP(ssize_t, sendto, (int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addr_len), (fd, buf, len, flags, addr, addr_len))
+WRAP(ssize_t, sendmsg, (int fd, const struct msghdr *msg, int flags), (fd, msg, flags))
+WRAP(int, setsockopt, (int fd, int level, int name, const void *val, socklen_t len), (fd, level, name, val, len))
+WRAP(int, getsockopt, (int fd, int level, int name, void *val, socklen_t *len), (fd, level, name, val, len))
+WRAP(int, shutdown, (int fd, int how), (fd, how))
+WRAP(int, close, (int fd), (fd))
+
+int __real_fcntl(int fd, int cmd, ...);
+int __wrap_fcntl(int fd, int cmd, ...) {
+	va_list ap;
+	va_start(ap, cmd);
+	long arg = va_arg(ap, long);
+	va_end(ap);
+	++syscalls;
+	return __real_fcntl(fd, cmd, arg);
+}
+
+
+/*
+	HELPERS
+*/
+
+static long long nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+
+// resident set size in bytes
+static long rss(void) {
+	long size = 0, resident = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if(!fp) return 0;
+	if(fscanf(fp, "%ld %ld", &size, &resident)!=2) resident = 0;
+	fclose(fp);
+	return resident*sysconf(_SC_PAGESIZE);
+}
+
+static int raiseFdLimit(long needed) {
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit)) return -1;
+	if((long)limit.rlim_cur>=needed) return 0;
+
+	// raising the hard limit needs privileges, the soft limit can go up to it
+	struct rlimit raised = {needed, (long)limit.rlim_max>needed?limit.rlim_max:(rlim_t)needed};
+	if(setrlimit(RLIMIT_NOFILE, &raised)==0) return 0;
+	limit.rlim_cur = limit.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &limit);
+	return (long)limit.rlim_max>=needed?0:-1;
+}
+
+static int compareLL(const void *a, const void *b) {
+	long long x = *(const long long*)a, y = *(const long long*)b;
+	return (x>y)-(x<y);
+}
+
+static double percentileUs(const long long *sorted, long count, double p) {
+	if(count<=0) return 0;
+	long index = (long)(p*(count-1)+0.5);
+	return sorted[index]/1000.0;
+}
+
+
+/*
+	SERVER
+*/
+
+static volatile sig_atomic_t running = 1;
+
+static void onTerm(int signum) {
+	(void)signum;
+	running = 0;
+}
+
+static void onEcho(csocket_multiHandler_t *handler, csocket_activity_t *activity) {
+	struct bench_shared *shared = handler->user;
+
+	if(activity->type&CSACT_TYPE_CONN)
+		++shared->accepted;
+	if(!(activity->type&CSACT_TYPE_READ)) return;
+
+	char buf[65536];
+	ssize_t len = csocket_recvA(activity, buf, sizeof buf, 0);
+	if(len<=0) {
+		activity->client_socket.shutdown = 1;
+		return;
+	}
+	for(ssize_t sent = 0, res; sent<len; sent += res) {
+		res = csocket_sendA(activity, buf+sent, len-sent, 0);
+		if(res<=0) {
+			activity->client_socket.shutdown = 1;
+			return;
+		}
+	}
+}
+
+static int runServer(const struct bench_config *config, struct bench_shared *shared, int ready) {
+	csocket_t socket = CSOCKET_EMPTY;
+	csocket_multiHandler_t handler = CSOCKET_EMPTY;
+	csocket_keepalive_t ka = CSOCKET_EMPTY;
+
+	signal(SIGTERM, onTerm);
+
+	if(csocket_initServerSocket(AF_INET, SOCK_STREAM, 0, (void*)&inaddr_any, config->port, &socket, 1)) return 1;
+	if(config->keepalive) {
+		if(csocket_keepalive_create(0, NULL, 0, &ka, &socket)) return 1;
+		csocket_keepalive_set(&ka, &socket);
+	}
+	if(csocket_bindServer(&socket) || csocket_listen(&socket, CONNECT_WINDOW)) return 1;
+	if(csocket_setUpMultiServer2(&socket, config->connections, onEcho, shared, &handler)) return 1;
+	shared->rss_base = rss();
+
+	// signal the parent
+	if(write(ready, "r", 1)!=1) return 1;
+	close(ready);
+
+	long iter = 0;
+	while(running) {
+		// sleep in poll on the set of the last iteration instead of spinning
+		poll(handler.pfds, handler.maxClients+1, 1);
+
+		int measure = shared->active && iter<config->iterations;
+		unsigned long calls = syscalls;
+		long long start = nowNs();
+		if(csocket_multiServer(&handler)) break;
+
+		if(shared->accepted==config->connections && !shared->rss_full)
+			shared->rss_full = rss();
+		if(measure) {
+			shared->iter_ns[iter++] = nowNs()-start;
+			shared->syscalls += syscalls-calls;
+			if(iter==config->iterations)
+				shared->measured = 1;
+		}
+	}
+
+	csocket_close(&socket);
+	csocket_freeMultiHandler(&handler);
+	return 0;
+}
+
+
+/*
+	CLIENTS
+*/
+
+static int openConnection(const struct bench_config *config, long index) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd<0) return -1;
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	struct sockaddr_in addr = {.sin_family = AF_INET};
+	// spread over 127.0.0.x, each source address has its own ephemeral ports
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK+1+index/CONNS_PER_ADDR);
+	#ifdef IP_BIND_ADDRESS_NO_PORT
+		int one = 1;
+		setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof one);
+	#endif
+	if(bind(fd, (struct sockaddr*)&addr, sizeof addr)) {
+		close(fd);
+		return -1;
+	}
+
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(config->port);
+	if(connect(fd, (struct sockaddr*)&addr, sizeof addr) && errno!=EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// closed loop over the active subset until the server has measured
+static long runActive(const struct bench_config *config, struct bench_shared *shared, const int *fds) {
+	char *msg = malloc(config->size), *buf = malloc(config->size);
+	long msgs = 0;
+	if(!msg || !buf) return -1;
+	memset(msg, 'x', config->size);
+
+	for(int i=0; i<config->active; ++i) {
+		int flg = fcntl(fds[i], F_GETFL);
+		fcntl(fds[i], F_SETFL, flg&~O_NONBLOCK);
+	}
+	shared->active = 1;
+
+	long long end = nowNs()+60*1000000000LL;
+	while(!shared->measured && nowNs()<end) {
+		for(int i=0; i<config->active; ++i) {
+			if(send(fds[i], msg, config->size, 0)!=(ssize_t)config->size) goto fail;
+		}
+		for(int i=0; i<config->active; ++i) {
+			for(size_t got = 0; got<config->size;) {
+				ssize_t res = recv(fds[i], buf+got, config->size-got, 0);
+				if(res<=0) goto fail;
+				got += res;
+			}
+			++msgs;
+		}
+	}
+	if(!shared->measured) msgs = -1;
+
+	free(msg);
+	free(buf);
+	return msgs;
+
+fail:
+	free(msg);
+	free(buf);
+	return -1;
+}
+
+static int runCount(struct bench_config config) {
+	size_t shared_len = sizeof(struct bench_shared)+config.iterations*sizeof(long long);
+	struct bench_shared *shared = mmap(NULL, shared_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	int *fds = calloc(config.connections, sizeof(int));
+	if(shared==MAP_FAILED || !fds) return -1;
+
+	// server
+	int pipefd[2];
+	if(pipe(pipefd)) return -1;
+	pid_t server = fork();
+	if(server<0) return -1;
+	if(server==0) {
+		close(pipefd[0]);
+		_exit(runServer(&config, shared, pipefd[1]));
+	}
+	close(pipefd[1]);
+	char ready;
+	if(read(pipefd[0], &ready, 1)!=1) {
+		fprintf(stderr, "server failed\n");
+		waitpid(server, NULL, 0);
+		return -1;
+	}
+	close(pipefd[0]);
+
+	// accept the whole set, the window keeps the accept queue from overflowing
+	long opened = 0;
+	long long start = nowNs(), end = start+120*1000000000LL;
+	for(; opened<config.connections && nowNs()<end; ++opened) {
+		while(opened-shared->accepted>=CONNECT_WINDOW && nowNs()<end)
+			usleep(100);
+		if((fds[opened] = openConnection(&config, opened))<0) break;
+	}
+	while(shared->accepted<opened && nowNs()<end)
+		usleep(100);
+	double accept_secs = (nowNs()-start)/1e9;
+	long accepted = shared->accepted;
+
+	long msgs = -1;
+	if(accepted==config.connections)
+		msgs = runActive(&config, shared, fds);
+
+	kill(server, SIGTERM);
+	waitpid(server, NULL, 0);
+
+	long iterations = shared->measured?config.iterations:0;
+	qsort(shared->iter_ns, iterations, sizeof(long long), compareLL);
+	long long iter_total = 0;
+	for(long i=0; i<iterations; ++i)
+		iter_total += shared->iter_ns[i];
+
+	printf("{\"bench\":\"scale\",\"connections\":%ld,\"accepted\":%ld,\"active\":%d,\"size\":%zu,\"keepalive\":%d,\"accept_secs\":%.3f,"
+		"\"iterations\":%ld,\"msgs\":%ld,\"iter_mean_us\":%.2f,\"iter_p50_us\":%.2f,\"iter_p99_us\":%.2f,\"syscalls_per_iter\":%.2f,"
+		"\"rss_per_conn_bytes\":%.1f}\n",
+		config.connections, accepted, config.active, config.size, config.keepalive, accept_secs,
+		iterations, msgs, iterations?iter_total/1e3/iterations:0,
+		percentileUs(shared->iter_ns, iterations, 0.5), percentileUs(shared->iter_ns, iterations, 0.99),
+		iterations?(double)shared->syscalls/iterations:0,
+		shared->rss_full?(double)(shared->rss_full-shared->rss_base)/config.connections:0);
+
+	for(long i=0; i<opened; ++i)
+		if(fds[i]>0) close(fds[i]);
+	free(fds);
+	munmap(shared, shared_len);
+	return msgs<0?-1:0;
+}
+
+
+int main(int argc, char **argv) {
+
+	struct bench_config config = {.active = 16, .iterations = 1000, .size = 64, .keepalive = 0, .port = 4260};
+	long counts[MAX_COUNTS] = {1000, 10000, 50000};
+	int num_counts = 0;
+
+	for(int i=1; i<argc; ++i) {
+		if(strcmp(argv[i], "-k")==0) config.keepalive = 1;
+		else if(i+1<argc && strcmp(argv[i], "-c")==0 && num_counts<MAX_COUNTS) counts[num_counts++] = atol(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-a")==0) config.active = atoi(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-i")==0) config.iterations = atol(argv[++i]);
+		else if(i+1<argc && strcmp(argv[i], "-s")==0) config.size = strtoul(argv[++i], NULL, 10);
+		else if(i+1<argc && strcmp(argv[i], "-p")==0) config.port = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-c connections]... [-a active] [-i iterations] [-s size] [-k] [-p port]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(!num_counts) num_counts = 3;
+	if(config.active<1 || config.iterations<1 || config.size<1 || config.size>65536) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+
+	int failed = 0;
+	for(int i=0; i<num_counts; ++i) {
+		config.connections = counts[i];
+		if(config.connections<config.active) {
+			fprintf(stderr, "invalid parameters\n");
+			return 1;
+		}
+		// one set of connections per process, some spare for the rest
+		if(raiseFdLimit(config.connections+64)) {
+			fprintf(stderr, "RLIMIT_NOFILE too low for %ld connections\n", config.connections);
+			failed = 1;
+			continue;
+		}
+		if(runCount(config)) failed = 1;
+		// separate port per run, no leftovers of the previous one
+		++config.port;
+	}
+
+	return failed;
+}
@@ -3,6 +3,8 @@
 #add header
 cp src/*.h bin/
 
+# USDT probes: add -DCSOCKET_USDT to both compile steps (needs sys/sdt.h)
+
 ## static
 
 #compile
@@ -14,4 +14,9 @@ gcc -o bin/simpleClient6.o simpleClient6.c -static -l:libcsocket.a -L../bin -I..
 gcc -o bin/simpleServer6.o simpleServer6.c -static -l:libcsocket.a -L../bin -I../bin
 gcc -o bin/multiServer6.o multiServer6.c -static -l:libcsocket.a -L../bin -I../bin
 
+gcc -o bin/simpleClientUnix.o simpleClientUnix.c -static -l:libcsocket.a -L../bin -I../bin
+gcc -o bin/multiServerUnix.o multiServerUnix.c -static -l:libcsocket.a -L../bin -I../bin
+
+gcc -o bin/preforkServer.o preforkServer.c -static -l:libcsocket.a -L../bin -I../bin
+
 strip -s bin/*.o
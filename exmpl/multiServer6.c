@@ -64,7 +64,7 @@ int main(void) {
 
 	while(loop) {
 		if(csocket_multiServer(&handler)) {
-			printf("multiServer failed: %s\n", socket.last_err);
+			printf("multiServer failed: %s\n", csocket_strerror(socket.err));
 			break;
 		}
 	}
@@ -0,0 +1,102 @@
+/**
+ * @file preforkServer.c
+ * @author Felix Kröhnert (felix.kroehnert@online.de)
+ * @brief
+ * @version 0.1
+ * @date 2022-11-06
+ *
+ * @copyright Copyright (c) 2022
+ *
+**/
+
+
+#include <signal.h>
+#include <stdio.h>
+#include "csocket.h"
+
+
+int loop = 1;
+
+
+void onkill(int signum) {
+	loop = 0;
+	printf("\r");
+}
+
+void onActivity(csocket_multiHandler_t *handler, csocket_activity_t *act) {
+	// echo data, handled by one of the workers
+	if(act->type&CSACT_TYPE_READ) {
+		char arr[1024];
+		ssize_t rval = csocket_recvA(act, arr, sizeof(arr), 0);
+		if(rval<=0) {
+			act->client_socket.shutdown = 1;
+			return;
+		}
+		printf("[worker %d] received[%zd]: '%.*s'\n", getpid(), rval, (int)rval, arr);
+		csocket_sendA(act, arr, rval, 0);
+	}
+	else if(act->type&CSACT_TYPE_CONN)
+		printf("[worker %d] new client\n", getpid());
+}
+
+int worker(csocket_t *socket, int index, void *user) {
+	// SIGTERM of csocket_prefork_stop ends the loop as well
+	signal(SIGTERM, onkill);
+
+	csocket_multiHandler_t handler = CSOCKET_EMPTY;
+	int rval = csocket_setUpMultiServer2(socket, 64, &onActivity, NULL, &handler);
+	printf("[worker %d] %d setting up multiServer: %d\n", getpid(), index, rval);
+	if(rval) return 1;
+
+	while(loop) {
+		// sleep up to 100 ms until the listener or a client is ready
+		if(csocket_multiServerWait(&handler, &(struct timespec){0, 100000000})) {
+			printf("[worker %d] multiServer failed: %s\n", getpid(), csocket_strerror(socket->err));
+			break;
+		}
+	}
+
+	csocket_freeMultiHandler(&handler);
+	return 0;
+}
+
+int main(void) {
+
+	signal(SIGINT, onkill);
+
+	csocket_t socket = CSOCKET_EMPTY;
+	csocket_prefork_t prefork = CSOCKET_EMPTY;
+	int rval;
+
+	rval = csocket_initServerSocket(AF_INET, SOCK_STREAM, 0, (void*)&inaddr_any, 4200, &socket, 1);
+	printf("init: %d\n", rval);
+	if(rval) return 1;
+
+	// bind and listen once, the listener is shared by all workers
+	rval = csocket_bindServer(&socket);
+	printf("binding: %d\n", rval);
+	if(rval) return 1;
+	rval = csocket_listen(&socket, 64);
+	printf("listening: %d\n", rval);
+	if(rval) return 1;
+
+	rval = csocket_prefork_create(&socket, 4, 0, &worker, NULL, &prefork);
+	printf("forking workers: %d\n", rval);
+	if(rval) return 1;
+
+	// restart crashed workers
+	while(loop) {
+		rval = csocket_prefork_supervise(&prefork);
+		if(rval<0)
+			printf("restart failed: %s\n", csocket_strerror(socket.err));
+		usleep(100000);
+	}
+
+	rval = csocket_prefork_stop(&prefork, &(struct timespec){2, 0});
+	printf("stopped, %d killed\n", rval);
+	csocket_freePrefork(&prefork);
+	csocket_close(&socket);
+	printf("closed\n");
+
+	return 0;
+}
@@ -31,7 +31,7 @@ int main(void) {
 	CSOCKET_NTOP(socket.domain, socket.mode.addr, str, 100);
 
 	// enable default keep alive
-	printf("Setting keepalive: %d %s\n", csocket_keepalive_create(0, NULL, 0, &ka, &socket), socket.last_err);
+	printf("Setting keepalive: %d %s\n", csocket_keepalive_create(0, NULL, 0, &ka, &socket), csocket_strerror(socket.err));
 	csocket_keepalive_set(&ka, &socket);
 	printf("Settings:\n\tEnabled: %d\n\tTimeout: %d\n\tMSG: %s\n\tType: %d\n\tTime: %ld\n", socket.ka->enabled, socket.ka->timeout, socket.ka->msg, socket.ka->msg_type, socket.ka->last_sig);
 
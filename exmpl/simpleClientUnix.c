@@ -0,0 +1,48 @@
+/**
+ * @file simpleClientUnix.c
+ * @author Felix Kröhnert (felix.kroehnert@online.de)
+ * @brief 
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+**/
+
+
+#include <stdio.h>
+#include "csocket.h"
+
+int main(void) {
+
+	csocket_t socket = CSOCKET_EMPTY;
+	int rval;
+	char str[100];
+	struct timeval timeout = {
+		.tv_sec = 0,
+		.tv_usec = 500000,
+	};
+
+	rval = csocket_initClientSocket(AF_UNIX, SOCK_STREAM, 0, "/tmp/csocket.sock", 0, &socket, 0);
+	printf("init: %d\n", rval);
+	if(rval) return 1;
+
+	CSOCKET_NTOP(socket.domain, socket.mode.addr, str, 100);
+
+	rval = csocket_connectClient(&socket, &timeout);
+	printf("connect[%s]: %d\n", str, rval);
+	if(rval) return 1;
+
+	char buf[12] = "hello world";
+	printf("sending: \"%s\"\n", buf);
+	rval = csocket_send(&socket, buf, 12, 0);
+	if(12!=rval) {
+		printf("Failed to send data [%d]\n", rval);
+		return 1;
+	}
+
+	csocket_close(&socket);
+	printf("closed\n");
+
+	return 0;
+}
\ No newline at end of file
@@ -30,7 +30,7 @@ int main(void) {
 	if(rval) return 1;
 
 	// enable default keep alive
-	printf("Setting keepalive: %d %s\n", csocket_keepalive_create(0, NULL, 0, &ka, &listener), listener.last_err);
+	printf("Setting keepalive: %d %s\n", csocket_keepalive_create(0, NULL, 0, &ka, &listener), csocket_strerror(listener.err));
 	csocket_keepalive_set(&ka, &listener);
 	printf("Settings:\n\tEnabled: %d\n\tTimeout: %d\n\tMSG: %s\n\tType: %d\n\tTime: %ld\n", listener.ka->enabled, listener.ka->timeout, listener.ka->msg, listener.ka->msg_type, listener.ka->last_sig);
 
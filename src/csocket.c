@@ -15,6 +15,13 @@
 
 const struct in_addr inaddr_any = {.s_addr = INADDR_ANY};
 struct timespec csocket_timeout = {0};
+static csocket_allocator_t _csocket_allocator = {0};
+// per-thread clock, sampled once per multiServer iteration
+static CS_THREAD_LOCAL struct {
+	int depth;
+	struct timespec now;
+	time_t wall;
+} _cs_clock;
 
 #pragma region SOCKET SETUP
 
@@ -24,12 +31,16 @@ static int _initSocket(int domain, int type, int protocol, void *addrc, int port
 	csocket_free(src_socket);
 
 	if(!addrc && !specialAddr) {
-		strcpy(src_socket->last_err, "missing: addr");
+		_csError(src_socket, CSERR_ADDR);
 		return -1;
 	}
 
-	if(domain!=AF_INET&&domain!=AF_INET6) {
-		strcpy(src_socket->last_err, "invalid domain");
+	#ifdef _WIN32
+		if(domain!=AF_INET&&domain!=AF_INET6) {
+	#else
+		if(domain!=AF_INET&&domain!=AF_INET6&&domain!=AF_UNIX) {
+	#endif
+		_csError(src_socket, CSERR_DOMAIN);
 		return -1;
 	}
 
@@ -40,7 +51,7 @@ static int _initSocket(int domain, int type, int protocol, void *addrc, int port
 
 	// create socket
 	if((src_socket->mode.fd = socket(domain, type, protocol)) < 0) {
-		strcpy(src_socket->last_err, "create socket");
+		_csError(src_socket, CSERR_SOCKET);
 		return -1;
 	}
 
@@ -52,14 +63,14 @@ int csocket_setAddress(struct sockaddr **out_addr, socklen_t *addr_len, int doma
 	if(!out_addr || !addr_len || (!addrc && !specialAddr)) return -1;
 	// set address
 	if(domain == AF_INET) {
-		struct sockaddr_in *addr = calloc(1, sizeof(struct sockaddr_in));
+		struct sockaddr_in *addr = _csCalloc(NULL, 1, sizeof(struct sockaddr_in));
 		if(!addr) {
 			return -1;
 		}
 		addr->sin_family = AF_INET;
 		if(!specialAddr) {
 			if(1!=inet_pton(AF_INET, (char*)addrc, &addr->sin_addr)) {
-				free(addr);
+				_csFree(NULL, addr);
 				return -1;
 			}
 		}
@@ -73,14 +84,14 @@ int csocket_setAddress(struct sockaddr **out_addr, socklen_t *addr_len, int doma
 
 	}
 	else if(domain == AF_INET6) {
-		struct sockaddr_in6 *addr = calloc(1, sizeof(struct sockaddr_in6));
+		struct sockaddr_in6 *addr = _csCalloc(NULL, 1, sizeof(struct sockaddr_in6));
 		if(!addr) {
 			return -1;
 		}
 		addr->sin6_family = AF_INET6;
 		if(!specialAddr) {
 			if(1!=inet_pton(AF_INET6, (char*)addrc, &addr->sin6_addr)) {
-				free(addr);
+				_csFree(NULL, addr);
 				return -1;
 			}
 		}
@@ -92,6 +103,28 @@ int csocket_setAddress(struct sockaddr **out_addr, socklen_t *addr_len, int doma
 		*out_addr = (struct sockaddr*) addr;
 		*addr_len = sizeof(struct sockaddr_in6);
 	}
+	#ifndef _WIN32
+	else if(domain == AF_UNIX) {
+		// addrc is the path, a leading '@' selects the abstract namespace, port and specialAddr are unused
+		const char *path = addrc;
+		size_t path_len = path?strlen(path):0;
+		if(path_len==0 || (path[0]=='@' && path_len==1) || path_len>=sizeof(((struct sockaddr_un*)0)->sun_path)) {
+			return -1;
+		}
+		struct sockaddr_un *addr = _csCalloc(NULL, 1, sizeof(struct sockaddr_un));
+		if(!addr) {
+			return -1;
+		}
+		addr->sun_family = AF_UNIX;
+		memcpy(addr->sun_path, path, path_len);
+		if(path[0]=='@')
+			addr->sun_path[0] = 0;
+
+		*out_addr = (struct sockaddr*) addr;
+		// abstract names are not terminated
+		*addr_len = offsetof(struct sockaddr_un, sun_path)+path_len+(path[0]=='@'?0:1);
+	}
+	#endif
 	else {
 		return -1;
 	}
@@ -99,6 +132,24 @@ int csocket_setAddress(struct sockaddr **out_addr, socklen_t *addr_len, int doma
 	return 0;
 }
 
+// domain of an accepted peer, unused bytes of Unix addresses are cleared for csocket_ntop
+static int _peerDomain(struct sockaddr *addr, socklen_t addr_len, socklen_t size) {
+	if(!addr || addr_len<(socklen_t)sizeof(addr->sa_family)) return -1;
+
+	int domain = addr->sa_family;
+	if(domain==AF_INET && addr_len==sizeof(struct sockaddr_in)) return AF_INET;
+	if(domain==AF_INET6 && addr_len==sizeof(struct sockaddr_in6)) return AF_INET6;
+	#ifndef _WIN32
+		if(domain==AF_UNIX) {
+			if(addr_len<size)
+				memset((char*)addr+addr_len, 0, size-addr_len);
+			return AF_UNIX;
+		}
+	#endif
+	(void)size;
+	return -1;
+}
+
 
 int csocket_setAddressA(csocket_addr_t *out_addr, int domain, void *addrc, int port, int specialAddr) {
 	if(!out_addr) return -1;
@@ -109,8 +160,8 @@ int csocket_initServerSocket(int domain, int type, int protocol, void *addrc, in
 
 	if(_initSocket(domain, type, protocol, addrc, port, src_socket, specialAddr)) return -1;
 	src_socket->mode.sc = 1;
-	// set reusable ports
-	{
+	// set reusable ports, Unix sockets have none
+	if(src_socket->domain!=AF_UNIX) {
 		#ifdef _WIN32
 			char
 		#else 
@@ -118,7 +169,7 @@ int csocket_initServerSocket(int domain, int type, int protocol, void *addrc, in
 		#endif 
 			opt = 1;
 		if(setsockopt(src_socket->mode.fd, SOL_SOCKET, SO_REUSEADDR|SO_REUSEPORT, &opt, sizeof(opt))) {
-			strcpy(src_socket->last_err, "setsockopt");
+			_csError(src_socket, CSERR_SOCKOPT);
 			return -1;
 		}
 	}
@@ -129,6 +180,16 @@ int csocket_initServerSocket(int domain, int type, int protocol, void *addrc, in
 int csocket_initClientSocket(int domain, int type, int protocol, void *addrc, int port, csocket_t *src_socket, int specialAddr) {
 	int rv = _initSocket(domain, type, protocol, addrc, port, src_socket, specialAddr);
 	src_socket->mode.sc = 2;
+	#ifdef __linux__
+		// unbound Unix datagram sockets cannot be answered, take an abstract name from the kernel
+		if(!rv && domain==AF_UNIX && type==SOCK_DGRAM) {
+			struct sockaddr_un local = {.sun_family = AF_UNIX};
+			if(bind(src_socket->mode.fd, (struct sockaddr*)&local, sizeof(sa_family_t))) {
+				_csError(src_socket, CSERR_BIND);
+				rv = -1;
+			}
+		}
+	#endif
 	return rv;
 }
 
@@ -136,7 +197,7 @@ int csocket_initClientSocket(int domain, int type, int protocol, void *addrc, in
 
 #pragma region RECV/SEND
 
-static int _hasRecvData(int fd) {
+static int _hasRecvData(int fd, csocket_stats_t *stats) {
 	char buf;
 	int res = 0;
 	// disable block and test recv
@@ -144,11 +205,11 @@ static int _hasRecvData(int fd) {
 		{
 			u_long iMode = 1;
 			ioctlsocket(fd, FIONBIO, &iMode);
-			res = (recv(fd, &buf, 1, MSG_PEEK)==1);
+			res = (_statRecv(stats, recv(fd, &buf, 1, MSG_PEEK), MSG_PEEK)==1);
 		}
 	#else
 		fcntl(fd, F_SETFL, O_NONBLOCK);
-		res = (recv(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT)==1);
+		res = (_statRecv(stats, recv(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT), MSG_PEEK)==1);
 	#endif
 	
 
@@ -167,7 +228,7 @@ static int _hasRecvData(int fd) {
 	return res;
 }
 
-static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len) {
+static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len, csocket_stats_t *stats) {
 	char buf;
 	int res = 0;
 	// disable block and test recv
@@ -175,11 +236,11 @@ static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len)
 		{
 			u_long iMode = 1;
 			ioctlsocket(fd, FIONBIO, &iMode);
-			res = (recvfrom(fd, &buf, 1, MSG_PEEK, addr, addr_len)==1);
+			res = (_statRecv(stats, recvfrom(fd, &buf, 1, MSG_PEEK, addr, addr_len), MSG_PEEK)==1);
 		}
 	#else
 		fcntl(fd, F_SETFL, O_NONBLOCK);
-		res = (recvfrom(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT, addr, addr_len)==1);
+		res = (_statRecv(stats, recvfrom(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT, addr, addr_len), MSG_PEEK)==1);
 	#endif
 	
 
@@ -201,49 +262,139 @@ static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len)
 // read/write
 int csocket_hasRecvData(csocket_t *src_socket) {
 	if(!src_socket) return -1;
-	strcpy(src_socket->last_err, "");
-	if(src_socket->ka && src_socket->ka->enabled) {
+	src_socket->err = CSERR_NONE;
+	if(_kaBuffered(src_socket->ka)) {
 		return _hasRecvDataBuffer(src_socket->ka, src_socket->mode.fd);
 	}
-	return _hasRecvData(src_socket->mode.fd);
+	return _hasRecvData(src_socket->mode.fd, &src_socket->stats);
 }
 
 int csocket_hasRecvFromData(csocket_t *src_socket, csocket_addr_t *dst_addr) {
 	if(!src_socket||!dst_addr) return -1;
-	strcpy(src_socket->last_err, "");
-	if(src_socket->ka && src_socket->ka->enabled) {
+	src_socket->err = CSERR_NONE;
+	if(_kaBuffered(src_socket->ka)) {
 		return _hasRecvFromDataBuffer(src_socket->ka, src_socket->mode.fd, dst_addr->addr, &dst_addr->addr_len);
 	}
-	return _hasRecvFromData(src_socket->mode.fd, dst_addr->addr, &dst_addr->addr_len);
+	return _hasRecvFromData(src_socket->mode.fd, dst_addr->addr, &dst_addr->addr_len, &src_socket->stats);
 }
 
 ssize_t csocket_recv(csocket_t *src_socket, void *buf, size_t len, int flags) {
 	if(!src_socket) return -1;
-	strcpy(src_socket->last_err, "");
-	if(src_socket->ka && src_socket->ka->enabled) {
+	src_socket->err = CSERR_NONE;
+	if(_kaBuffered(src_socket->ka)) {
 		return _readBuffer(src_socket, buf, len, flags);
 	}
-	return recv(src_socket->mode.fd, buf, len, flags);
+	return _statRecv(&src_socket->stats, recv(src_socket->mode.fd, buf, len, flags), flags);
 }
 
 ssize_t csocket_recvfrom(csocket_t *src_socket, csocket_addr_t *dst_addr, void *buf, size_t len, int flags) {
 	if(!src_socket||!dst_addr) return -1;
-	if(src_socket->ka && src_socket->ka->enabled) {
+	src_socket->err = CSERR_NONE;
+	if(_kaBuffered(src_socket->ka)) {
 		return _readFromBuffer(src_socket, dst_addr, buf, len, flags);
 	}
-	return recvfrom(src_socket->mode.fd, buf, len, flags, dst_addr->addr, &dst_addr->addr_len);
+	return _statRecv(&src_socket->stats, recvfrom(src_socket->mode.fd, buf, len, flags, dst_addr->addr, &dst_addr->addr_len), flags);
+}
+
+ssize_t csocket_recvDeadline(csocket_t *src_socket, void *buf, size_t len, int flags, const struct timespec *deadline) {
+	if(!src_socket) return -1;
+	src_socket->err = CSERR_NONE;
+	if(_kaBuffered(src_socket->ka)) {
+		return _readBufferA(_sockAct(src_socket, NULL), buf, len, flags, deadline);
+	}
+	if(!(flags&MSG_DONTWAIT) && _pollFd(src_socket->mode.fd, POLLIN, deadline)<=0) return -1;
+	return _statRecv(&src_socket->stats, recv(src_socket->mode.fd, buf, len, flags), flags);
+}
+
+int csocket_deadline(struct timespec *deadline, const struct timespec *timeout) {
+	if(!deadline || !timeout) return -1;
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout->tv_sec;
+	deadline->tv_nsec += timeout->tv_nsec;
+	if(deadline->tv_nsec>=1000000000L) {
+		deadline->tv_sec += deadline->tv_nsec/1000000000L;
+		deadline->tv_nsec %= 1000000000L;
+	}
+	return 0;
+}
+
+int csocket_setTimeout(csocket_t *src_socket, const struct timespec *timeout) {
+	if(!src_socket) return -1;
+	src_socket->err = CSERR_NONE;
+	if(timeout)
+		src_socket->timeout = *timeout;
+	else
+		src_socket->timeout = (const struct timespec){0};
+	return 0;
+}
+
+// timeout of a socket, zero falls back to csocket_timeout
+static const struct timespec * _csTimeout(const struct timespec *timeout) {
+	if(timeout->tv_sec<=0 && timeout->tv_nsec<=0) return &csocket_timeout;
+	return timeout;
+}
+
+// deadline for a relative timeout, NULL if the timeout is zero (no timeout)
+static const struct timespec * _deadline(struct timespec *deadline, const struct timespec *timeout) {
+	if(timeout->tv_sec<=0 && timeout->tv_nsec<=0) return NULL;
+	csocket_deadline(deadline, timeout);
+	return deadline;
+}
+
+// block until fd has events or the deadline passes, 1 on events, 0 on timeout (errno ETIMEDOUT), -1 on error
+static int _pollFd(int fd, short events, const struct timespec *deadline) {
+	struct pollfd pfd = {.fd = fd, .events = events};
+	for(;;) {
+		int wait_ms = -1;
+		if(deadline) {
+			struct timespec cs;
+			clock_gettime(CLOCK_MONOTONIC, &cs);
+			long long ns = (long long)(deadline->tv_sec-cs.tv_sec)*1000000000LL+(deadline->tv_nsec-cs.tv_nsec);
+			if(ns<=0) {
+				errno = ETIMEDOUT;
+				return 0;
+			}
+			// round up, never wake before the deadline
+			wait_ms = ns/1000000LL+(ns%1000000LL?1:0);
+		}
+		#ifdef _WIN32
+			int res = WSAPoll(&pfd, 1, wait_ms);
+		#else
+			int res = poll(&pfd, 1, wait_ms);
+		#endif
+		if(res>0) return 1;
+		if(res<0 && errno!=EINTR) return -1;
+	}
+}
+
+// readiness of fd without waiting (no FD_SETSIZE limit), revents or -1 on error
+static int _pollNow(int fd, short events) {
+	struct pollfd pfd = {.fd = fd, .events = events};
+	#ifdef _WIN32
+		int res = WSAPoll(&pfd, 1, 0);
+	#else
+		int res = poll(&pfd, 1, 0);
+	#endif
+	if(res<0) return -1;
+	return pfd.revents;
 }
 
 ssize_t csocket_send(csocket_t *src_socket, void *buf, size_t len, int flags) {
 	if(!src_socket) return -1;
-	strcpy(src_socket->last_err, "");
-	return send(src_socket->mode.fd, buf, len, flags);
+	src_socket->err = CSERR_NONE;
+	if(src_socket->ka && src_socket->ka->enabled && src_socket->ka->mode==CSKA_MODE_FRAMED) {
+		return _sendFrame(src_socket->mode.fd, CSKA_FRAME_DATA, buf, len, flags, &src_socket->stats);
+	}
+	return _statSend(&src_socket->stats, send(src_socket->mode.fd, buf, len, flags));
 }
 
 ssize_t csocket_sendto(csocket_t *src_socket, void *buf, size_t len, int flags) {
 	if(!src_socket) return -1;
-	strcpy(src_socket->last_err, "");
-	return sendto(src_socket->mode.fd, buf, len, flags, src_socket->mode.addr, src_socket->mode.addr_len);
+	src_socket->err = CSERR_NONE;
+	if(src_socket->ka && src_socket->ka->enabled && src_socket->ka->mode==CSKA_MODE_FRAMED) {
+		return _sendFrame(src_socket->mode.fd, CSKA_FRAME_DATA, buf, len, flags, &src_socket->stats);
+	}
+	return _statSend(&src_socket->stats, sendto(src_socket->mode.fd, buf, len, flags, src_socket->mode.addr, src_socket->mode.addr_len));
 }
 
 #pragma endregion
@@ -252,6 +403,12 @@ ssize_t csocket_sendto(csocket_t *src_socket, void *buf, size_t len, int flags)
 
 static int _hasRecvDataBuffer(csocket_keepalive_t *ka, int fd) {
 	if(!ka) return -1;
+	if(ka->mode==CSKA_MODE_KERNEL) return 0;
+	if(ka->enabled && ka->mode==CSKA_MODE_FRAMED) {
+		char buf;
+		if(_updateFrames(ka, fd)<0 || ka->frame_remaining==0) return 0;
+		return _recvNb(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT, ka->stats)==1;
+	}
 	_updateBuffer(ka, fd, MSG_PEEK|MSG_DONTWAIT);
 	if(ka->buffer_usage>0) return 1;
 	return 0;
@@ -259,6 +416,7 @@ static int _hasRecvDataBuffer(csocket_keepalive_t *ka, int fd) {
 
 static int _hasRecvFromDataBuffer(csocket_keepalive_t *ka, int fd, struct sockaddr *addr, socklen_t *addr_len) {
 	if(!ka) return -1;
+	if(ka->enabled && ka->mode==CSKA_MODE_FRAMED) return _hasRecvDataBuffer(ka, fd);
 	_updateFromBuffer(ka, fd, MSG_PEEK|MSG_DONTWAIT, addr, addr_len);
 	if(ka->buffer_usage>0) return 1;
 	return 0;
@@ -266,7 +424,12 @@ static int _hasRecvFromDataBuffer(csocket_keepalive_t *ka, int fd, struct sockad
 
 // update internal buffer
 static ssize_t _updateBuffer(csocket_keepalive_t *ka, int fd, int flags) {
-	if(!ka || !ka->enabled) return -1;
+	if(!ka || !ka->enabled || ka->mode==CSKA_MODE_KERNEL) return -1;
+
+	if(ka->mode==CSKA_MODE_FRAMED) {
+		if(_updateFrames(ka, fd)<0 || ka->frame_remaining==0) return -1;
+		return 0;
+	}
 
 	if(ka->buffer_usage==ka->buffer_len) {
 		return 0;
@@ -283,14 +446,14 @@ static ssize_t _updateBuffer(csocket_keepalive_t *ka, int fd, int flags) {
 				u_long iMode = 1;
 				ioctlsocket(fd, FIONBIO, &iMode);
 			}
-			res = recv(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_DONTWAIT&~MSG_PEEK);
+			res = _statRecv(ka->stats, recv(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_DONTWAIT&~MSG_PEEK), 0);
 			lasterr = errno;
 		}
 	#else
 		if(flags&MSG_DONTWAIT) {
 			fcntl(fd, F_SETFL, O_NONBLOCK);
 		}
-		res = recv(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_PEEK);
+		res = _statRecv(ka->stats, recv(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_PEEK), 0);
 		lasterr = errno;
 	#endif
 
@@ -311,6 +474,8 @@ static ssize_t _updateBuffer(csocket_keepalive_t *ka, int fd, int flags) {
 	if(res<=0 && (ka->buffer_usage > 0 || lasterr == EAGAIN || lasterr == EWOULDBLOCK))return 0;
 	if(res<=0 && ka->buffer_usage <= 0) return -1;
 	ka->buffer_usage = offset+res;
+	_statBuffer(ka->stats, ka->buffer_usage);
+	CS_PROBE3(buffer__fill, fd, ka->buffer_usage, ka->buffer_len);
 
 	// search buffer for keepalive and set ka->last_sig
 	size_t length = ka->buffer_usage;
@@ -320,7 +485,12 @@ static ssize_t _updateBuffer(csocket_keepalive_t *ka, int fd, int flags) {
 		SEARCH FOR RESOLVED QUERY and remove from buffer + update ka->last_sig
 	*/
 	if(!_findKeepAliveMsg(ka->msg, ka->msg_len, ka->buffer, &ka->buffer_usage, ka->params, &ka->params_usage)) {
-		ka->last_sig = time(NULL);
+		if(ka->stats) {
+			++ka->stats->ka_seen;
+			ka->stats->ka_bytes += length-ka->buffer_usage;
+		}
+		CS_PROBE2(ka__seen, fd, length-ka->buffer_usage);
+		_kaSignal(ka);
 		if(ka->onActivity && ka->connection_time!=0) ka->onActivity(ka);
 	}
 
@@ -334,7 +504,10 @@ static ssize_t _updateBuffer(csocket_keepalive_t *ka, int fd, int flags) {
 
 // update internal buffer (from)
 static ssize_t _updateFromBuffer(csocket_keepalive_t *ka, int fd, int flags, struct sockaddr *addr, socklen_t *addr_len) {
-	if(!ka || !ka->enabled) return -1;
+	if(!ka || !ka->enabled || ka->mode==CSKA_MODE_KERNEL) return -1;
+
+	if(ka->mode==CSKA_MODE_FRAMED)
+		return _updateBuffer(ka, fd, flags);
 
 	if(ka->buffer_usage==ka->buffer_len) {
 		return 0;
@@ -351,14 +524,14 @@ static ssize_t _updateFromBuffer(csocket_keepalive_t *ka, int fd, int flags, str
 				u_long iMode = 1;
 				ioctlsocket(fd, FIONBIO, &iMode);
 			}
-			res = recvfrom(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_DONTWAIT&~MSG_PEEK, addr, addr_len);
+			res = _statRecv(ka->stats, recvfrom(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_DONTWAIT&~MSG_PEEK, addr, addr_len), 0);
 			lasterr = errno;
 		}
 	#else
 		if(flags&MSG_DONTWAIT) {
 			fcntl(fd, F_SETFL, O_NONBLOCK);
 		}
-		res = recvfrom(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_PEEK, addr, addr_len);
+		res = _statRecv(ka->stats, recvfrom(fd, ka->buffer+offset, ka->buffer_len-offset, flags&~MSG_PEEK, addr, addr_len), 0);
 		lasterr = errno;
 	#endif
 	
@@ -380,6 +553,8 @@ static ssize_t _updateFromBuffer(csocket_keepalive_t *ka, int fd, int flags, str
 	if(res<=0 && (ka->buffer_usage > 0 || lasterr == EAGAIN || lasterr == EWOULDBLOCK))return 0;
 	if(res<=0 && ka->buffer_usage <= 0) return -1;
 	ka->buffer_usage = offset+res;
+	_statBuffer(ka->stats, ka->buffer_usage);
+	CS_PROBE3(buffer__fill, fd, ka->buffer_usage, ka->buffer_len);
 
 	// search buffer for keepalive and set ka->last_sig
 	size_t length = ka->buffer_usage;
@@ -389,7 +564,12 @@ static ssize_t _updateFromBuffer(csocket_keepalive_t *ka, int fd, int flags, str
 		SEARCH FOR RESOLVED QUERY and remove from buffer + update ka->last_sig
 	*/
 	if(!_findKeepAliveMsg(ka->msg, ka->msg_len, ka->buffer, &ka->buffer_usage, ka->params, &ka->params_usage)) {
-		ka->last_sig = time(NULL);
+		if(ka->stats) {
+			++ka->stats->ka_seen;
+			ka->stats->ka_bytes += length-ka->buffer_usage;
+		}
+		CS_PROBE2(ka__seen, fd, length-ka->buffer_usage);
+		_kaSignal(ka);
 		if(ka->onActivity && ka->connection_time!=0) ka->onActivity(ka);
 	}
 
@@ -401,42 +581,72 @@ static ssize_t _updateFromBuffer(csocket_keepalive_t *ka, int fd, int flags, str
 	return 0;
 }
 
+// embedded activity of the socket, no allocation and no poll
+static csocket_activity_t * _sockAct(csocket_t *src_socket, csocket_addr_t *dst_addr) {
+	csocket_activity_t *activity = &src_socket->act;
+
+	if(!src_socket->act_init) {
+		*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+		activity->time = _csTime();
+		src_socket->act_init = 1;
+	}
+	activity->type = 0;
+	activity->client_socket.fd = src_socket->mode.fd;
+	activity->client_socket.domain = src_socket->domain;
+	activity->client_socket.ka = src_socket->ka;
+	activity->client_socket.timeout = src_socket->timeout;
+	activity->client_socket.stats = &src_socket->stats;
+	if(dst_addr) {
+		activity->client_socket.addr = dst_addr->addr;
+		activity->client_socket.addr_len = dst_addr->addr_len;
+	}
+	else {
+		activity->client_socket.addr = src_socket->mode.addr;
+		activity->client_socket.addr_len = src_socket->mode.addr_len;
+	}
+
+	return activity;
+}
+
 static ssize_t _readBuffer(csocket_t *src_socket, void *buf, size_t len, int flags) {
-	
-	csocket_activity_t *activity = csocket_sockToAct(src_socket);
-	if(activity) {
-		return _readBufferA(activity, buf, len, flags);
+	csocket_activity_t *activity = _sockAct(src_socket, NULL);
+	struct timespec deadline;
+	return _readBufferA(activity, buf, len, flags, _deadline(&deadline, _csTimeout(&activity->client_socket.timeout)));
+}
+
+// wait until the buffer holds data, 1 on data, 0 on timeout, -1 if the peer is gone
+static int _waitBuffer(csocket_activity_t *activity, const struct timespec *deadline, int from) {
+	csocket_keepalive_t *ka = activity->client_socket.ka;
+	int fd = activity->client_socket.fd;
+
+	for(;;) {
+		if(from)
+			_updateFromBuffer(ka, fd, MSG_DONTWAIT, activity->client_socket.addr, &activity->client_socket.addr_len);
+		else
+			_updateBuffer(ka, fd, MSG_DONTWAIT);
+		if(ka->buffer_usage>0) return 1;
+
+		// nothing but keepalives so far, EOF and errors stay readable
+		char c;
+		ssize_t res = _recvNb(fd, &c, 1, MSG_PEEK|MSG_DONTWAIT, ka->stats);
+		if(res==0) return -1;
+		if(res<0 && errno!=EAGAIN && errno!=EWOULDBLOCK) return -1;
+
+		int ret = _pollFd(fd, POLLIN, deadline);
+		if(ret<=0) return ret;
 	}
-	return -1;
 }
 
-static ssize_t _readBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
+static ssize_t _readBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline) {
 	int res = 0;
 
-	// timeout
-	struct timespec ts, cs;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	ts.tv_sec+=csocket_timeout.tv_sec;
-	ts.tv_nsec+=csocket_timeout.tv_nsec;
+	if(activity->client_socket.ka->mode==CSKA_MODE_FRAMED)
+		return _readFrameA(activity, buf, len, flags, deadline);
 
 	if(!buf || len==0) return -1;
-	do {
-		csocket_updateA(activity);
+	if(!(flags&MSG_DONTWAIT) && _waitBuffer(activity, deadline, 0)<=0)
+		return -1;
 
-		// timeout 
-		clock_gettime(CLOCK_MONOTONIC, &cs);
-		if((csocket_timeout.tv_sec>0||csocket_timeout.tv_nsec>0)&&((ts.tv_sec == cs.tv_sec && ts.tv_nsec < cs.tv_nsec) || ts.tv_sec < cs.tv_sec)) {
-			break;
-		}
-	} while(!(activity->type&CSACT_TYPE_READ));
-	
-	while(!_hasRecvDataBuffer(activity->client_socket.ka, activity->client_socket.fd)) {
-		// timeout
-		clock_gettime(CLOCK_MONOTONIC, &cs);
-		if((csocket_timeout.tv_sec>0||csocket_timeout.tv_nsec>0)&&((ts.tv_sec == cs.tv_sec && ts.tv_nsec < cs.tv_nsec) || ts.tv_sec < cs.tv_sec)) {
-			break;
-		}
-	}
 	if(_updateBuffer(activity->client_socket.ka, activity->client_socket.fd, flags|MSG_DONTWAIT))
 		return -1;
 	
@@ -459,42 +669,23 @@ static ssize_t _readBufferA(csocket_activity_t *activity, void *buf, size_t len,
 
 static ssize_t _readFromBuffer(csocket_t *src_socket, csocket_addr_t *dst_addr, void *buf, size_t len, int flags) {
 	
-	csocket_activity_t *activity = csocket_sockToActA(src_socket, dst_addr);
-	if(activity) {
-		int rv = _readFromBufferA(activity, buf, len, flags);
-		dst_addr->addr_len = activity->client_socket.addr_len;
-		return rv;
-	}
-	return -1;
+	csocket_activity_t *activity = _sockAct(src_socket, dst_addr);
+	struct timespec deadline;
+	ssize_t rv = _readFromBufferA(activity, buf, len, flags, _deadline(&deadline, _csTimeout(&activity->client_socket.timeout)));
+	dst_addr->addr_len = activity->client_socket.addr_len;
+	return rv;
 }
 
-static ssize_t _readFromBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
+static ssize_t _readFromBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline) {
 	int res = 0;
 
-	// timeout
-	struct timespec ts, cs;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	ts.tv_sec+=csocket_timeout.tv_sec;
-	ts.tv_nsec+=csocket_timeout.tv_nsec;
+	if(activity->client_socket.ka->mode==CSKA_MODE_FRAMED)
+		return _readFrameA(activity, buf, len, flags, deadline);
 
 	if(!buf || len==0) return -1;
-	do {
-		csocket_updateFromA(activity);
+	if(!(flags&MSG_DONTWAIT) && _waitBuffer(activity, deadline, 1)<=0)
+		return -1;
 
-		// timeout
-		clock_gettime(CLOCK_MONOTONIC, &cs);
-		if((csocket_timeout.tv_sec>0||csocket_timeout.tv_nsec>0)&&((ts.tv_sec == cs.tv_sec && ts.tv_nsec < cs.tv_nsec) || ts.tv_sec < cs.tv_sec)) {
-			break;
-		}
-	} while(!(activity->type&CSACT_TYPE_READ));
-	
-	while(!_hasRecvFromDataBuffer(activity->client_socket.ka, activity->client_socket.fd, activity->client_socket.addr, &activity->client_socket.addr_len)) {
-		// timeout
-		clock_gettime(CLOCK_MONOTONIC, &cs);
-		if((csocket_timeout.tv_sec>0||csocket_timeout.tv_nsec>0)&&((ts.tv_sec == cs.tv_sec && ts.tv_nsec < cs.tv_nsec) || ts.tv_sec < cs.tv_sec)) {
-			break;
-		}
-	}
 	if(_updateFromBuffer(activity->client_socket.ka, activity->client_socket.fd, flags|MSG_DONTWAIT, activity->client_socket.addr, &activity->client_socket.addr_len))
 		return -1;
 	
@@ -543,6 +734,7 @@ static int _findKeepAliveMsg(char *msg, size_t msg_len, char *buffer, socklen_t
 	size_t msg_offset = 0;
 
 	socklen_t var_len = msg_len;
+	socklen_t match_start = 0;
 
 	int foundKA = 0;
 
@@ -550,39 +742,363 @@ static int _findKeepAliveMsg(char *msg, size_t msg_len, char *buffer, socklen_t
 	for(socklen_t buffer_offset = 0; buffer_offset < *buffer_usage; ++buffer_offset) {
 		
 		if(*(msg+msg_offset)==*(buffer+buffer_offset)) {
+			if(msg_offset==0) match_start = buffer_offset;
 			
-			if(msg_offset==msg_len-1) {
-				
-				memcpy(params, buffer+(buffer_offset)-(var_len-1), var_len);
-				
-				*params_usage = var_len;
-				params[var_len+1] = 0;
-				
-				memmove(buffer+(buffer_offset)-(var_len-1), buffer+(buffer_offset+1), *buffer_usage-(buffer_offset));
-				*buffer_usage-=var_len;
-
-				msg_offset = 0;
-				buffer_offset = (buffer_offset)-(var_len-2);
-				foundKA = 1;
-			}
-			else {
+			if(msg_offset!=msg_len-1) {
 				// search keywords
 				if(_searchKeyKeepAlive("%UNIX%", 6, msg, &msg_offset, buffer, &buffer_offset, *buffer_usage, &var_len) +
 				_searchKeyKeepAlive("%HOST%", 6, msg, &msg_offset, buffer, &buffer_offset, *buffer_usage, &var_len) +
 				_searchKeyKeepAlive("%USER%", 6, msg, &msg_offset, buffer, &buffer_offset, *buffer_usage, &var_len) <= -3) {
 					++msg_offset;
 				}
+				// a template may end with a keyword
+				if(msg_offset<msg_len) continue;
 			}
+
+			memcpy(params, buffer+match_start, var_len);
+			
+			*params_usage = var_len;
+			params[var_len] = 0;
+			
+			memmove(buffer+match_start, buffer+buffer_offset+1, *buffer_usage-buffer_offset-1);
+			*buffer_usage-=var_len;
+
+			msg_offset = 0;
+			var_len = msg_len;
+			// continue right after the removed keepalive (unsigned wrap at 0)
+			buffer_offset = match_start-1;
+			foundKA = 1;
 		}
-		else {
+		else if(msg_offset>0) {
+			// retry from the byte after the start of the failed match
 			msg_offset = 0;
 			var_len = msg_len;
+			buffer_offset = match_start;
 		}
 	}
 
 	return !foundKA;
 }
 
+static ssize_t _recvNb(int fd, void *buf, size_t len, int flags, csocket_stats_t *stats) {
+	ssize_t res = 0;
+	#ifdef _WIN32
+		if(flags&MSG_DONTWAIT) {
+			u_long iMode = 1;
+			ioctlsocket(fd, FIONBIO, &iMode);
+		}
+		res = recv(fd, (char*)buf, len, flags&~MSG_DONTWAIT);
+		if(flags&MSG_DONTWAIT) {
+			u_long iMode = 0;
+			ioctlsocket(fd, FIONBIO, &iMode);
+		}
+	#else
+		res = recv(fd, buf, len, flags);
+	#endif
+	return _statRecv(stats, res, flags);
+}
+
+// consume keepalive frames up to the next data frame
+static int _updateFrames(csocket_keepalive_t *ka, int fd) {
+	if(!ka || !ka->enabled) return -1;
+
+	while(ka->frame_remaining==0) {
+		unsigned char hdr[CSKA_FRAME_HDRLEN];
+		ssize_t res = _recvNb(fd, hdr, CSKA_FRAME_HDRLEN, MSG_PEEK|MSG_DONTWAIT, ka->stats);
+		if(res==0) return -1;
+		if(res<0) return (errno==EAGAIN || errno==EWOULDBLOCK)?0:-1;
+		if(res<CSKA_FRAME_HDRLEN) return 0;
+
+		size_t frame_len = ((size_t)hdr[1]<<24)|((size_t)hdr[2]<<16)|((size_t)hdr[3]<<8)|(size_t)hdr[4];
+
+		if(hdr[0]==CSKA_FRAME_DATA) {
+			_recvNb(fd, hdr, CSKA_FRAME_HDRLEN, MSG_DONTWAIT, ka->stats);
+			ka->frame_remaining = frame_len;
+		}
+		else if(hdr[0]==CSKA_FRAME_KEEPALIVE) {
+			if(!ka->params || frame_len+CSKA_FRAME_HDRLEN>(size_t)ka->params_len) return -1;
+
+			// wait for the complete frame
+			res = _recvNb(fd, ka->params, frame_len+CSKA_FRAME_HDRLEN, MSG_PEEK|MSG_DONTWAIT, ka->stats);
+			if(res<(ssize_t)(frame_len+CSKA_FRAME_HDRLEN)) return res<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK?-1:0;
+			_recvNb(fd, ka->params, frame_len+CSKA_FRAME_HDRLEN, MSG_DONTWAIT, ka->stats);
+			if(ka->stats) {
+				++ka->stats->ka_seen;
+				ka->stats->ka_bytes += frame_len+CSKA_FRAME_HDRLEN;
+			}
+			CS_PROBE2(ka__seen, fd, frame_len+CSKA_FRAME_HDRLEN);
+
+			memmove(ka->params, ka->params+CSKA_FRAME_HDRLEN, frame_len);
+			ka->params_usage = frame_len;
+			ka->params[frame_len] = 0;
+
+			_kaSignal(ka);
+			if(ka->onActivity && ka->connection_time!=0) ka->onActivity(ka);
+		}
+		else {
+			// unknown frame, stream is out of sync
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t _readFrameA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline) {
+	csocket_keepalive_t *ka = activity->client_socket.ka;
+
+	if(!buf || len==0) return -1;
+	for(;;) {
+		if(_updateFrames(ka, activity->client_socket.fd)<0) return -1;
+		if(ka->frame_remaining>0) break;
+		if(flags&MSG_DONTWAIT) {
+			errno = EAGAIN;
+			return -1;
+		}
+		if(_pollFd(activity->client_socket.fd, POLLIN, deadline)<=0) return -1;
+	}
+
+	// payload goes straight to the caller, it may still be in flight
+	if(len>ka->frame_remaining)
+		len = ka->frame_remaining;
+	if(deadline && !(flags&MSG_DONTWAIT) && _pollFd(activity->client_socket.fd, POLLIN, deadline)<=0) return -1;
+	ssize_t res = _recvNb(activity->client_socket.fd, buf, len, flags, ka->stats);
+	if(res>0 && !(flags&MSG_PEEK))
+		ka->frame_remaining -= res;
+
+	return res;
+}
+
+static ssize_t _sendFrame(int fd, unsigned char type, const void *buf, size_t len, int flags, csocket_stats_t *stats) {
+	if(!buf && len>0) return -1;
+	if(len>0xFFFFFFFFul) return -1;
+
+	unsigned char hdr[CSKA_FRAME_HDRLEN];
+	hdr[0] = type;
+	hdr[1] = (len>>24)&0xFF;
+	hdr[2] = (len>>16)&0xFF;
+	hdr[3] = (len>>8)&0xFF;
+	hdr[4] = len&0xFF;
+
+	#ifdef _WIN32
+		if(_statSend(stats, send(fd, (const char*)hdr, CSKA_FRAME_HDRLEN, flags))!=CSKA_FRAME_HDRLEN) return -1;
+		size_t sent = 0;
+		while(sent<len) {
+			int r = _statSend(stats, send(fd, (const char*)buf+sent, len-sent, flags));
+			if(r<=0) return -1;
+			sent += r;
+		}
+	#else
+		// header and payload in one syscall, no copy
+		struct iovec iov[2] = {
+			{.iov_base = hdr, .iov_len = CSKA_FRAME_HDRLEN},
+			{.iov_base = (void*)buf, .iov_len = len},
+		};
+		struct msghdr msg = {0};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = len>0?2:1;
+
+		size_t total = CSKA_FRAME_HDRLEN+len, sent = 0;
+		while(sent<total) {
+			ssize_t r = _statSend(stats, sendmsg(fd, &msg, flags));
+			if(r<=0) {
+				if(sent==0) return -1;
+				if(r<0 && (errno==EINTR||errno==EAGAIN||errno==EWOULDBLOCK)) continue;
+				return -1;
+			}
+			sent += r;
+			// a frame must not be left incomplete
+			flags &= ~MSG_DONTWAIT;
+			while(r>0) {
+				if((size_t)r>=msg.msg_iov->iov_len) {
+					r -= msg.msg_iov->iov_len;
+					msg.msg_iov++;
+					msg.msg_iovlen--;
+				}
+				else {
+					msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base+r;
+					msg.msg_iov->iov_len -= r;
+					r = 0;
+				}
+			}
+		}
+	#endif
+
+	return len;
+}
+
+static int _kaBuffered(const csocket_keepalive_t *ka) {
+	return ka && ka->enabled && ka->mode!=CSKA_MODE_KERNEL;
+}
+
+static int _setKernelKeepAlive(int fd, int timeout) {
+	int opt = 1;
+	if(setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (const void*)&opt, sizeof(opt))) return -1;
+	if(timeout<1) return 0;
+
+	// probing starts after timeout/2, 4 probes every timeout/8 -> dead after ~timeout
+	int idle = timeout/2>0?timeout/2:1;
+	int intvl = timeout/8>0?timeout/8:1;
+	int cnt = 4;
+	#ifdef TCP_KEEPIDLE
+		if(setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, (const void*)&idle, sizeof(idle))) return -1;
+	#endif
+	#ifdef TCP_KEEPINTVL
+		if(setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, (const void*)&intvl, sizeof(intvl))) return -1;
+	#endif
+	#ifdef TCP_KEEPCNT
+		if(setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, (const void*)&cnt, sizeof(cnt))) return -1;
+	#endif
+	#ifdef TCP_USER_TIMEOUT
+		// unacknowledged data
+		unsigned int user_timeout = (unsigned int)timeout*1000;
+		if(setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, (const void*)&user_timeout, sizeof(user_timeout))) return -1;
+	#endif
+	(void)idle; (void)intvl; (void)cnt;
+
+	return 0;
+}
+
+// collect a socket error or EOF of a readable socket
+static void _updateKernelKeepAlive(csocket_keepalive_t *ka, int fd) {
+	if(!ka || ka->error) return;
+
+	char buf;
+	ssize_t res = _recvNb(fd, &buf, 1, MSG_PEEK|MSG_DONTWAIT, ka->stats);
+	if(res==0)
+		ka->error = ENOTCONN;
+	else if(res<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)
+		ka->error = errno;
+	else if(res>0)
+		_kaSignal(ka);
+}
+
+#pragma endregion
+
+#pragma region SLAB
+
+static int _slabInit(struct csocket_slab *slab, int capacity, const csocket_allocator_t *allocator) {
+	if(!slab || capacity<1) return -1;
+
+	slab->slots = _csCalloc(allocator, capacity, sizeof(struct csocket_slot));
+	if(!slab->slots) return -1;
+	slab->capacity = capacity;
+
+	// chain all slots, lowest index is handed out first
+	for(int i=0; i<capacity; ++i)
+		slab->slots[i].next = i+1<capacity?i+1:-1;
+	slab->free_head = 0;
+
+	return 0;
+}
+
+static int _slabAlloc(struct csocket_slab *slab) {
+	if(!slab || !slab->slots || slab->free_head<0) return -1;
+
+	int index = slab->free_head;
+	slab->free_head = slab->slots[index].next;
+	slab->slots[index].next = -1;
+	slab->slots[index].stats = (const csocket_stats_t)CSOCKET_EMPTY;
+
+	return index;
+}
+
+static void _slabRelease(struct csocket_slab *slab, int index) {
+	if(!slab || !slab->slots || index<0 || index>=slab->capacity) return;
+
+	struct csocket_slot *slot = &slab->slots[index];
+
+	// keep the keepalive buffers for the next client
+	slot->ka.enabled = 0;
+	slot->ka.buffer_usage = 0;
+	slot->ka.params_usage = 0;
+	slot->ka.frame_remaining = 0;
+	slot->ka.error = 0;
+	slot->ka.onActivity = NULL;
+	slot->ka.fd = 0;
+	slot->ka.address = (const csocket_addr_t)CSOCKET_EMPTY;
+	slot->ka.connection_time = 0;
+
+	slot->framer.start = 0;
+	slot->framer.usage = 0;
+	slot->framer.scanned = 0;
+
+	slot->next = slab->free_head;
+	slab->free_head = index;
+}
+
+static void _slabFree(struct csocket_slab *slab, const csocket_allocator_t *allocator) {
+	if(!slab) return;
+
+	if(slab->slots) {
+		for(int i=0; i<slab->capacity; ++i) {
+			_freeKeepalive(&slab->slots[i].ka, allocator);
+			_freeFramer(&slab->slots[i].framer, allocator);
+		}
+		_csFree(allocator, slab->slots);
+	}
+
+	// reset
+	*slab = (const struct csocket_slab)CSOCKET_EMPTY;
+	slab->free_head = -1;
+}
+
+#pragma endregion
+
+#pragma region ALLOCATOR
+
+int csocket_setAllocator(csocket_multiHandler_t *handler, const csocket_allocator_t *allocator) {
+	if(allocator && (!allocator->alloc || !allocator->resize || !allocator->release)) return -1;
+
+	csocket_allocator_t *dst = handler?&handler->allocator:&_csocket_allocator;
+	if(allocator)
+		*dst = *allocator;
+	else
+		*dst = (const csocket_allocator_t)CSOCKET_EMPTY;
+
+	return 0;
+}
+
+static const csocket_allocator_t * _resolveAllocator(const csocket_allocator_t *allocator) {
+	// handler -> global -> libc (NULL)
+	if(allocator && allocator->alloc) return allocator;
+	if(_csocket_allocator.alloc) return &_csocket_allocator;
+	return NULL;
+}
+
+static void * _csMalloc(const csocket_allocator_t *allocator, size_t size) {
+	allocator = _resolveAllocator(allocator);
+	if(!allocator) return malloc(size);
+	return allocator->alloc(size, allocator->ctx);
+}
+
+static void * _csCalloc(const csocket_allocator_t *allocator, size_t nmemb, size_t size) {
+	allocator = _resolveAllocator(allocator);
+	if(!allocator) return calloc(nmemb, size);
+	if(allocator->zalloc) return allocator->zalloc(nmemb, size, allocator->ctx);
+
+	if(size && nmemb>((size_t)-1)/size) return NULL;
+	void *ptr = allocator->alloc(nmemb*size, allocator->ctx);
+	if(ptr) memset(ptr, 0, nmemb*size);
+	return ptr;
+}
+
+static void * _csRealloc(const csocket_allocator_t *allocator, void *ptr, size_t size) {
+	allocator = _resolveAllocator(allocator);
+	if(!allocator) return realloc(ptr, size);
+	return allocator->resize(ptr, size, allocator->ctx);
+}
+
+static void _csFree(const csocket_allocator_t *allocator, void *ptr) {
+	if(!ptr) return;
+	allocator = _resolveAllocator(allocator);
+	if(!allocator) {
+		free(ptr);
+		return;
+	}
+	allocator->release(ptr, allocator->ctx);
+}
+
 #pragma endregion
 
 #pragma region ACTIVITY
@@ -591,30 +1107,23 @@ void csocket_updateA(csocket_activity_t *activity) {
 	if(!activity) return;
 
 	// poll action
-	fd_set wr, rd, ex;
-	FD_ZERO(&wr);
-	FD_ZERO(&rd);
-	FD_ZERO(&ex);
-	FD_SET(activity->client_socket.fd, &wr);
-	FD_SET(activity->client_socket.fd, &rd);
-	FD_SET(activity->client_socket.fd, &ex);
-	struct timeval TIMEVAL_ZERO = {0};
-	int ret = select(activity->client_socket.fd+1, &rd, &wr, &ex, &TIMEVAL_ZERO);
+	int ret = _pollNow(activity->client_socket.fd, POLLIN|POLLOUT|CS_POLLEX);
 	if(ret < 0) {
 		return;
 	}
 
 	// set time
-	activity->update_time = time(NULL);
+	activity->update_time = _csTime();
+	activity->ts = *_csNow();
 
-	if(FD_ISSET(activity->client_socket.fd, &wr))
+	if(ret&(POLLOUT|POLLERR))
 		activity->type |= CSACT_TYPE_WRITE;
-	if(FD_ISSET(activity->client_socket.fd, &rd) || (activity->client_socket.ka && activity->client_socket.ka->buffer_usage>0))
+	if(ret&(POLLIN|POLLHUP|POLLERR) || (activity->client_socket.ka && activity->client_socket.ka->buffer_usage>0))
 		activity->type |= CSACT_TYPE_READ;
 	else if(csocket_hasRecvDataA(activity)==0)
 		activity->type &= ~CSACT_TYPE_READ;
 
-	if(FD_ISSET(activity->client_socket.fd, &ex))
+	if(ret&CS_POLLEX)
 		activity->type |= CSACT_TYPE_EXT;
 }
 
@@ -622,99 +1131,111 @@ void csocket_updateFromA(csocket_activity_t *activity) {
 	if(!activity) return;
 
 	// poll action
-	fd_set wr, rd, ex;
-	FD_ZERO(&wr);
-	FD_ZERO(&rd);
-	FD_ZERO(&ex);
-	FD_SET(activity->client_socket.fd, &wr);
-	FD_SET(activity->client_socket.fd, &rd);
-	FD_SET(activity->client_socket.fd, &ex);
-	struct timeval TIMEVAL_ZERO = {0};
-	int ret = select(activity->client_socket.fd+1, &rd, &wr, &ex, &TIMEVAL_ZERO);
+	int ret = _pollNow(activity->client_socket.fd, POLLIN|POLLOUT|CS_POLLEX);
 	if(ret < 0) {
 		return;
 	}
 
 	// set time
-	activity->update_time = time(NULL);
+	activity->update_time = _csTime();
+	activity->ts = *_csNow();
 
-	if(FD_ISSET(activity->client_socket.fd, &wr))
+	if(ret&(POLLOUT|POLLERR))
 		activity->type |= CSACT_TYPE_WRITE;
-	if(FD_ISSET(activity->client_socket.fd, &rd) || (activity->client_socket.ka && activity->client_socket.ka->buffer_usage>0))
+	if(ret&(POLLIN|POLLHUP|POLLERR) || (activity->client_socket.ka && activity->client_socket.ka->buffer_usage>0))
 		activity->type |= CSACT_TYPE_READ;
 	else if(csocket_hasRecvFromDataA(activity)==0)
 		activity->type &= ~CSACT_TYPE_READ;
 
-	if(FD_ISSET(activity->client_socket.fd, &ex))
+	if(ret&CS_POLLEX)
 		activity->type |= CSACT_TYPE_EXT;
 }
 
 void csocket_printActivity(FILE *fp, csocket_activity_t *activity) {
 	if(!fp) return;
 
-	char addrs[40];
-	CSOCKET_NTOP(activity->client_socket.domain, activity->client_socket.addr, addrs, 40);
+	char addrs[CSOCKET_ADDRSTRLEN] = "";
+	csocket_addr_t peer = {activity->client_socket.domain, activity->client_socket.addr, activity->client_socket.addr_len};
+	csocket_ntopA(&peer, addrs, sizeof(addrs));
 
 	fprintf(fp, "[%.24s] >> %s   Handle: [%d]\n", ctime(&activity->time), addrs, activity->client_socket.fd);
 	fprintf(fp, "\tLast update: %.24s\n", ctime(&activity->update_time));
 	fprintf(fp, "\tConnectedOn: %s", activity->client_socket.connection_time==0?"unknown\n":"");
 	if(activity->client_socket.connection_time!=0)
 		fprintf(fp, "%lu\n", (unsigned long)activity->client_socket.connection_time);
-	fprintf(fp, "\tType: %s%s%s%s%s%s\n", activity->type&CSACT_TYPE_CONN?"CONN ":"", activity->type&CSACT_TYPE_DISCONN?"DISCONN ":"", activity->type&CSACT_TYPE_READ?"READ ":"", activity->type&CSACT_TYPE_WRITE?"WRITE ":"", activity->type&CSACT_TYPE_EXT?"EXT ":"", activity->type&CSACT_TYPE_DECLINED?"DECLINED ":"");
+	fprintf(fp, "\tType: %s%s%s%s%s%s%s%s\n", activity->type&CSACT_TYPE_CONN?"CONN ":"", activity->type&CSACT_TYPE_DISCONN?"DISCONN ":"", activity->type&CSACT_TYPE_READ?"READ ":"", activity->type&CSACT_TYPE_WRITE?"WRITE ":"", activity->type&CSACT_TYPE_EXT?"EXT ":"", activity->type&CSACT_TYPE_DECLINED?"DECLINED ":"", activity->type&CSACT_TYPE_CONNOUT?"CONNOUT ":"", activity->type&CSACT_TYPE_CONNFAIL?"CONNFAIL ":"");
 	fprintf(fp, "\t\n");
 }
 
 int csocket_hasRecvDataA(csocket_activity_t *activity) {
 	if(!activity) return -1;
-	if(activity->client_socket.ka && activity->client_socket.ka->enabled) {
+	if(_kaBuffered(activity->client_socket.ka)) {
 		return _hasRecvDataBuffer(activity->client_socket.ka, activity->client_socket.fd);
 	}
-	return _hasRecvData(activity->client_socket.fd);
+	return _hasRecvData(activity->client_socket.fd, activity->client_socket.stats);
 }
 
 int csocket_hasRecvFromDataA(csocket_activity_t *activity) {
 	if(!activity) return -1;
-	if(activity->client_socket.ka && activity->client_socket.ka->enabled) {
+	if(_kaBuffered(activity->client_socket.ka)) {
 		return _hasRecvFromDataBuffer(activity->client_socket.ka, activity->client_socket.fd, activity->client_socket.addr, &activity->client_socket.addr_len);
 	}
-	return _hasRecvFromData(activity->client_socket.fd, activity->client_socket.addr, &activity->client_socket.addr_len);
+	return _hasRecvFromData(activity->client_socket.fd, activity->client_socket.addr, &activity->client_socket.addr_len, activity->client_socket.stats);
 }
 
 ssize_t csocket_recvA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
 	if(!activity) return -1;
-	if(activity->client_socket.ka && activity->client_socket.ka->enabled) {
-		return _readBufferA(activity, buf, len, flags);
+	if(_kaBuffered(activity->client_socket.ka)) {
+		struct timespec deadline;
+		return _readBufferA(activity, buf, len, flags, _deadline(&deadline, _csTimeout(&activity->client_socket.timeout)));
+	}
+	return _statRecv(activity->client_socket.stats, recv(activity->client_socket.fd, buf, len, flags), flags);
+}
+
+ssize_t csocket_recvDeadlineA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline) {
+	if(!activity) return -1;
+	if(_kaBuffered(activity->client_socket.ka)) {
+		return _readBufferA(activity, buf, len, flags, deadline);
 	}
-	return recv(activity->client_socket.fd, buf, len, flags);
+	if(!(flags&MSG_DONTWAIT) && _pollFd(activity->client_socket.fd, POLLIN, deadline)<=0) return -1;
+	return _statRecv(activity->client_socket.stats, recv(activity->client_socket.fd, buf, len, flags), flags);
 }
 
 ssize_t csocket_recvfromA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
 	if(!activity) return -1;
-	if(activity->client_socket.ka && activity->client_socket.ka->enabled) {
-		return _readFromBufferA(activity, buf, len, flags);
+	if(_kaBuffered(activity->client_socket.ka)) {
+		struct timespec deadline;
+		return _readFromBufferA(activity, buf, len, flags, _deadline(&deadline, _csTimeout(&activity->client_socket.timeout)));
 	}
-	return recvfrom(activity->client_socket.fd, buf, len, flags, activity->client_socket.addr, &activity->client_socket.addr_len);
+	return _statRecv(activity->client_socket.stats, recvfrom(activity->client_socket.fd, buf, len, flags, activity->client_socket.addr, &activity->client_socket.addr_len), flags);
 }
 
 ssize_t csocket_sendA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
 	if(!activity) return -1;
-	return send(activity->client_socket.fd, buf, len, flags);
+	if(activity->client_socket.ka && activity->client_socket.ka->enabled && activity->client_socket.ka->mode==CSKA_MODE_FRAMED) {
+		return _sendFrame(activity->client_socket.fd, CSKA_FRAME_DATA, buf, len, flags, activity->client_socket.stats);
+	}
+	return _statSend(activity->client_socket.stats, send(activity->client_socket.fd, buf, len, flags));
 }
 
 ssize_t csocket_sendtoA(csocket_activity_t *activity, void *buf, size_t len, int flags) {
 	if(!activity) return -1;
-	return sendto(activity->client_socket.fd, buf, len, flags, activity->client_socket.addr, activity->client_socket.addr_len);
+	if(activity->client_socket.ka && activity->client_socket.ka->enabled && activity->client_socket.ka->mode==CSKA_MODE_FRAMED) {
+		return _sendFrame(activity->client_socket.fd, CSKA_FRAME_DATA, buf, len, flags, activity->client_socket.stats);
+	}
+	return _statSend(activity->client_socket.stats, sendto(activity->client_socket.fd, buf, len, flags, activity->client_socket.addr, activity->client_socket.addr_len));
 }
 
 csocket_activity_t * csocket_sockToAct(csocket_t *src_socket) {
 	if(!src_socket) return NULL;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
-	csocket_activity_t *activity = calloc(1, sizeof(csocket_activity_t));
+	csocket_activity_t *activity = _csCalloc(NULL, 1, sizeof(csocket_activity_t));
 	if(!activity) return NULL;
 
-	activity->time = time(NULL);
+	activity->time = _csTime();
 	activity->update_time = activity->time;
+	activity->ts = *_csNow();
 	activity->client_socket = (const struct csocket_clients){0};
 	activity->client_socket.fd = src_socket->mode.fd;
 	activity->client_socket.domain = src_socket->domain;
@@ -728,13 +1249,14 @@ csocket_activity_t * csocket_sockToAct(csocket_t *src_socket) {
 
 csocket_activity_t * csocket_sockToActA(csocket_t *src_socket, csocket_addr_t *dst_addr) {
 	if(!src_socket||!dst_addr) return NULL;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
-	csocket_activity_t *activity = calloc(1, sizeof(csocket_activity_t));
+	csocket_activity_t *activity = _csCalloc(NULL, 1, sizeof(csocket_activity_t));
 	if(!activity) return NULL;
 
-	activity->time = time(NULL);
+	activity->time = _csTime();
 	activity->update_time = activity->time;
+	activity->ts = *_csNow();
 	activity->client_socket = (const struct csocket_clients){0};
 	activity->client_socket.fd = src_socket->mode.fd;
 	activity->client_socket.domain = src_socket->domain;
@@ -752,7 +1274,7 @@ csocket_activity_t * csocket_sockToActA(csocket_t *src_socket, csocket_addr_t *d
 
 int csocket_keepalive_create(int timeout, char *msg, size_t msg_len, csocket_keepalive_t *ka, csocket_t *src_socket) {
 	if(!src_socket || !ka) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
 	if(timeout<1) ka->timeout = CSKA_TIMEOUT;
 	else ka->timeout = timeout;
@@ -769,19 +1291,19 @@ int csocket_keepalive_create(int timeout, char *msg, size_t msg_len, csocket_kee
 		(char*)
 	#endif
 	&rcvfb, &len)) {
-		strcpy(src_socket->last_err, "kacreate getsockopt");
+		_csError(src_socket, CSERR_SOCKOPT);
 		return -1;
 	}
-	ka->buffer = malloc(rcvfb+1);
+	ka->buffer = _csMalloc(NULL, rcvfb+1);
 	ka->buffer_len = rcvfb;
 	if(!ka->buffer) {
-		strcpy(src_socket->last_err, "kacreate malloc");
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
-	ka->params = malloc(rcvfb+1);
+	ka->params = _csMalloc(NULL, rcvfb+1);
 	ka->params_len = rcvfb;
 	if(!ka->params) {
-		strcpy(src_socket->last_err, "kacreate malloc2");
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
 	
@@ -793,13 +1315,16 @@ int csocket_keepalive_create(int timeout, char *msg, size_t msg_len, csocket_kee
 		ka->msg_len = CSKA_DEFAULTMSGLEN;
 		ka->msg_type = 2;
 	}
-	ka->msg = malloc(ka->msg_len+1);
+	ka->msg = _csMalloc(NULL, ka->msg_len+1);
 	if(!ka->msg) {
-		strcpy(src_socket->last_err, "kacreate malloc3");
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
 	memcpy(ka->msg, msg_len>0?msg:CSKA_DEFAULTMSG, ka->msg_len);
 
+	// never signalled: not alive and the first keepalive is due
+	ka->last_sig = 0;
+	ka->last_seen = (struct timespec){0};
 	ka->enabled = 1;
 	
 	return 0;
@@ -807,7 +1332,7 @@ int csocket_keepalive_create(int timeout, char *msg, size_t msg_len, csocket_kee
 
 int csocket_keepalive_modify(int timeout, char *msg, size_t msg_len, csocket_keepalive_t *ka, csocket_t *src_socket) {
 	if(!src_socket || !ka) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
 	if(timeout<1) ka->timeout = CSKA_TIMEOUT;
 	else ka->timeout = timeout;
@@ -820,10 +1345,10 @@ int csocket_keepalive_modify(int timeout, char *msg, size_t msg_len, csocket_kee
 		ka->msg_len = CSKA_DEFAULTMSGLEN;
 		ka->msg_type = 2;
 	}
-	if(ka->msg) free(ka->msg);
-	ka->msg = malloc(ka->msg_len+1);
+	if(ka->msg) _csFree(NULL, ka->msg);
+	ka->msg = _csMalloc(NULL, ka->msg_len+1);
 	if(!ka->msg) {
-		strcpy(src_socket->last_err, "kamodify malloc2");
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
 	memcpy(ka->msg, msg_len>0?msg:CSKA_DEFAULTMSG, ka->msg_len);
@@ -835,83 +1360,145 @@ int csocket_keepalive_modify(int timeout, char *msg, size_t msg_len, csocket_kee
 
 int csocket_keepalive_set(csocket_keepalive_t *ka, csocket_t *src_socket) {
 	if(!src_socket || !ka) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 	src_socket->ka = ka;
+	ka->stats = &src_socket->stats;
 	return 0;
 }
 
 int csocket_keepalive_unset(csocket_t *src_socket) {
 	if(!src_socket || !src_socket->ka) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 	*src_socket->ka = (const csocket_keepalive_t)CSOCKET_EMPTY;
 	return 0;
 }
 
-int csocket_keepalive_copy(csocket_keepalive_t **dst, const csocket_keepalive_t *src) {
-	if(!dst||!src) return 0;
-
-	csocket_freeKeepalive(*dst);
+int csocket_keepalive_setMode(int mode, csocket_keepalive_t *ka, csocket_t *src_socket) {
+	if(!src_socket || !ka) return -1;
+	src_socket->err = CSERR_NONE;
 
-	if(!*dst) {
-		*dst = calloc(1, sizeof(csocket_keepalive_t));
-		if(!*dst) return -1;
+	if(mode!=CSKA_MODE_INBAND && mode!=CSKA_MODE_FRAMED && mode!=CSKA_MODE_KERNEL) {
+		_csError(src_socket, CSERR_INVAL);
+		return -1;
 	}
-
-	(*dst)->enabled = src->enabled;
-	(*dst)->timeout = src->timeout;
-	(*dst)->buffer = malloc(src->buffer_len);
-	(*dst)->buffer_len = src->buffer_len;
-	if(!(*dst)->buffer)
+	if(mode!=CSKA_MODE_INBAND && src_socket->type!=SOCK_STREAM) {
+		_csError(src_socket, CSERR_TYPE);
 		return -1;
-	(*dst)->params = malloc(src->params_len);
-	(*dst)->params_len = src->params_len;
-	if(!(*dst)->params)
+	}
+	// accepted sockets are configured again on accept
+	if(mode==CSKA_MODE_KERNEL && _setKernelKeepAlive(src_socket->mode.fd, ka->timeout)) {
+		_csError(src_socket, CSERR_SOCKOPT);
 		return -1;
-	(*dst)->msg_len = src->msg_len;
-	if((*dst)->msg_len>0) {
-		(*dst)->msg = malloc((*dst)->msg_len);
-		if(!(*dst)->msg)
+	}
+
+	ka->mode = mode;
+	ka->frame_remaining = 0;
+	ka->error = 0;
+	ka->buffer_usage = 0;
+
+	return 0;
+}
+
+int csocket_keepalive_copy(csocket_keepalive_t **dst, const csocket_keepalive_t *src) {
+	if(!dst||!src) return 0;
+
+	if(!*dst) {
+		*dst = _csCalloc(NULL, 1, sizeof(csocket_keepalive_t));
+		if(!*dst) return -1;
+	}
+
+	return _keepaliveCopy(*dst, src, NULL);
+}
+
+static int _keepaliveCopy(csocket_keepalive_t *dst, const csocket_keepalive_t *src, const csocket_allocator_t *allocator) {
+	if(!dst||!src) return 0;
+
+	// reuse buffers of matching size, reallocate otherwise
+	if(dst->buffer && dst->buffer_len!=src->buffer_len) {
+		_csFree(allocator, dst->buffer);
+		dst->buffer = NULL;
+	}
+	if(!dst->buffer) {
+		dst->buffer = _csMalloc(allocator, src->buffer_len+1);
+		if(!dst->buffer)
 			return -1;
-		memcpy((*dst)->msg, src->msg, (*dst)->msg_len);
 	}
-	(*dst)->msg_type = src->msg_type;
-	(*dst)->last_sig = time(NULL);
-	(*dst)->onActivity = src->onActivity;
+	dst->buffer_len = src->buffer_len;
+	dst->buffer_usage = 0;
 
-	(*dst)->fd = src->fd;
-	(*dst)->connection_time = src->connection_time;
-	(*dst)->address.domain = src->address.domain;
-	(*dst)->address.addr = src->address.addr;
-	(*dst)->address.addr_len = src->address.addr_len;
+	if(dst->params && dst->params_len!=src->params_len) {
+		_csFree(allocator, dst->params);
+		dst->params = NULL;
+	}
+	if(!dst->params) {
+		dst->params = _csMalloc(allocator, src->params_len+1);
+		if(!dst->params)
+			return -1;
+	}
+	dst->params_len = src->params_len;
+	dst->params_usage = 0;
 
+	if(dst->msg && dst->msg_len!=src->msg_len) {
+		_csFree(allocator, dst->msg);
+		dst->msg = NULL;
+	}
+	dst->msg_len = src->msg_len;
+	if(dst->msg_len>0) {
+		if(!dst->msg) {
+			dst->msg = _csMalloc(allocator, dst->msg_len);
+			if(!dst->msg)
+				return -1;
+		}
+		memcpy(dst->msg, src->msg, dst->msg_len);
+	}
+
+	dst->enabled = src->enabled;
+	dst->timeout = src->timeout;
+	dst->msg_type = src->msg_type;
+	dst->mode = src->mode;
+	dst->frame_remaining = 0;
+	dst->error = 0;
+	// counted by the new owner
+	dst->stats = NULL;
+	_kaSignal(dst);
+	dst->onActivity = src->onActivity;
+
+	dst->fd = src->fd;
+	dst->connection_time = src->connection_time;
+	dst->address.domain = src->address.domain;
+	dst->address.addr = src->address.addr;
+	dst->address.addr_len = src->address.addr_len;
 
 	return 0;
 }
 
 int csocket_isAlive(csocket_keepalive_t *ka) {
 	if(!ka || !ka->enabled) return -1;
+	if(ka->mode==CSKA_MODE_KERNEL) return !ka->error;
 	if(ka->timeout == 0) return 1;
 
-	return (ka->last_sig>(time(NULL)-ka->timeout));
+	return _kaWithin(ka, ka->timeout);
 }
 
 int csocket_keepAlive(csocket_t *src_socket) {
 	if(!src_socket || src_socket->mode.sc!=2 || !src_socket->ka) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 	
 	if(!src_socket->ka->enabled) {
-		strcpy(src_socket->last_err, "keepAlive unavailable: not enabled");
+		_csError(src_socket, CSERR_KADISABLED);
 		return -1;
 	}
-	if(src_socket->ka->last_sig>time(NULL)-src_socket->ka->timeout+src_socket->ka->timeout/4) {
-		strcpy(src_socket->last_err, "keepAlive unavailable: timeout");
+	// probes are sent by the kernel
+	if(src_socket->ka->mode==CSKA_MODE_KERNEL) return 0;
+	if(_kaWithin(src_socket->ka, src_socket->ka->timeout-src_socket->ka->timeout/4)) {
+		_csError(src_socket, CSERR_KANOTDUE);
 		return 0;
 	}	
 
 	size_t toSendSize = src_socket->ka->msg_len;
-	char *toSend = malloc(toSendSize);
+	char *toSend = _csMalloc(NULL, toSendSize);
 	if(!toSend) {
-		strcpy(src_socket->last_err, "keepAlive malloc");
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
 	memcpy(toSend, src_socket->ka->msg, toSendSize);
@@ -921,26 +1508,34 @@ int csocket_keepAlive(csocket_t *src_socket) {
 	for(size_t i=0; i<toSendSize; ++i) {
 		if((dst = csocket_resolveKeepAliveMsg(toSend+i, &size, &offset))) {
 			toSendSize += size;
-			char *n = realloc(toSend, toSendSize);
+			char *n = _csRealloc(NULL, toSend, toSendSize);
 			if(!n) {
-				strcpy(src_socket->last_err, "keepAlive realloc");
+				_csFree(NULL, toSend);
+				_csFree(NULL, dst);
+				_csError(src_socket, CSERR_ALLOC);
 				return -1;
 			}
 			toSend = n;
 			memmove(toSend+i+offset+size, toSend+i+offset, toSendSize-(i+offset+size));
 			memcpy(toSend+i+offset, dst, size);
 			i+=size+offset-1;
-			free(dst);
+			_csFree(NULL, dst);
 		}
 	}
 
-	src_socket->ka->last_sig = time(NULL);
+	_kaSignal(src_socket->ka);
 	
-	ssize_t r = csocket_send(src_socket, toSend, toSendSize, 0);
+	ssize_t r;
+	if(src_socket->ka->mode==CSKA_MODE_FRAMED)
+		r = _sendFrame(src_socket->mode.fd, CSKA_FRAME_KEEPALIVE, toSend, toSendSize, 0, &src_socket->stats);
+	else
+		r = csocket_send(src_socket, toSend, toSendSize, 0);
+	_csFree(NULL, toSend);
 	if(r<=0 || (size_t)r!=toSendSize) {
-		strcpy(src_socket->last_err, "keepAlive send");
+		_csError(src_socket, CSERR_SEND);
 		return -1;
 	}
+	++src_socket->stats.ka_sent;
 
 	return 0;
 }
@@ -955,11 +1550,11 @@ char * csocket_resolveKeepAliveMsg(char *src, size_t *size, size_t *offset) {
 	if(strncmp(src, "%UNIX%", 6)==0) {
 		char aunix[32];
 		memset(aunix, 0, sizeof aunix);
-		if((size_t)snprintf(aunix, sizeof aunix, "%ld", (unsigned long)time(NULL))>=(sizeof aunix))
+		if((size_t)snprintf(aunix, sizeof aunix, "%ld", (unsigned long)_csTime())>=(sizeof aunix))
 			return NULL;
 		*offset = 6;
 		*size = strlen(aunix)+*offset;
-		dst = malloc(*size);
+		dst = _csMalloc(NULL, *size);
 		if(!dst) return NULL;
 		memcpy(dst, aunix, *size-*offset);
 		memcpy(dst+*size-*offset, "%UNIX%", *offset);
@@ -971,7 +1566,7 @@ char * csocket_resolveKeepAliveMsg(char *src, size_t *size, size_t *offset) {
 			strcpy(host, "csckUnknown");
 		*offset = 6;
 		*size = strlen(host)+*offset;
-		dst = malloc(*size);
+		dst = _csMalloc(NULL, *size);
 		if(!dst) return NULL;
 		memcpy(dst, host, *size-*offset);
 		memcpy(dst+*size-*offset, "%HOST%", *offset);
@@ -989,7 +1584,7 @@ char * csocket_resolveKeepAliveMsg(char *src, size_t *size, size_t *offset) {
 		}
 		*offset = 6;
 		*size = strlen(user)+*offset;
-		dst = malloc(*size);
+		dst = _csMalloc(NULL, *size);
 		if(!dst) return NULL;
 		memcpy(dst, user, *size-*offset);
 		memcpy(dst+*size-*offset, "%USER%", *offset);
@@ -1023,7 +1618,7 @@ int csocket_getKeepAliveVariable(char *dst, size_t *dst_len, char *query, csocke
 
 int csocket_updateKeepAlive(csocket_keepalive_t *ka, int fd) {
 	if(!ka) return -1;
-	if(!ka->enabled) return 0;
+	if(!ka->enabled || ka->mode==CSKA_MODE_KERNEL) return 0;
 
 	if(_updateBuffer(ka, fd, MSG_PEEK|MSG_DONTWAIT)<0) {
 		return -1;
@@ -1034,7 +1629,7 @@ int csocket_updateKeepAlive(csocket_keepalive_t *ka, int fd) {
 
 int csocket_updateKeepAliveFrom(csocket_keepalive_t *ka, int fd, csocket_addr_t *dst_addr) {
 	if(!ka||!dst_addr) return -1;
-	if(!ka->enabled) return 0;
+	if(!ka->enabled || ka->mode==CSKA_MODE_KERNEL) return 0;
 
 	if(_updateFromBuffer(ka, fd, MSG_PEEK|MSG_DONTWAIT, dst_addr->addr, &dst_addr->addr_len)<0)
 		return -1;
@@ -1045,8 +1640,8 @@ int csocket_updateKeepAliveFrom(csocket_keepalive_t *ka, int fd, csocket_addr_t
 void csocket_printKeepAlive(FILE *fp, csocket_keepalive_t *ka) {
 	if(!fp) return;
 
-	char addrs[40];
-	CSOCKET_NTOP(ka->address.domain, ka->address.addr, addrs, 40);
+	char addrs[CSOCKET_ADDRSTRLEN] = "";
+	csocket_ntopA(&ka->address, addrs, sizeof(addrs));
 
 	fprintf(fp, "[%.24s] >> %s   Handle: [%d]\n", ctime(&ka->last_sig), addrs, ka->fd);
 	fprintf(fp, "\tTimeout: %d[s]\n\tType: KEEPALIVE\n\tHandlerEnabled: %d\n", ka->timeout, ka->onActivity!=0);
@@ -1063,82 +1658,132 @@ void csocket_printKeepAlive(FILE *fp, csocket_keepalive_t *ka) {
 // establish connection/bind socket
 int csocket_bindServer(csocket_t *src_socket){
 	if(!src_socket || src_socket->mode.sc!=1) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
 	// bind
 	struct csocket_server server = *((struct csocket_server*)&src_socket->mode);
+	#ifndef _WIN32
+		if(src_socket->domain==AF_UNIX)
+			_unlinkStale(server.addr, server.addr_len, src_socket->type);
+	#endif
 	if(bind(server.server_fd, server.addr, server.addr_len)) {
-		strcpy(src_socket->last_err, "bind");
+		_csError(src_socket, CSERR_BIND);
 		return -1;
 	}
 
 	return 0;
 }
 
+#ifndef _WIN32
+// remove the socket file of a server that is gone, other files and live sockets are kept
+static void _unlinkStale(const struct sockaddr *addr, socklen_t addr_len, int type) {
+	const struct sockaddr_un *un = (const struct sockaddr_un*)addr;
+	struct stat st;
+	if(!un->sun_path[0] || stat(un->sun_path, &st) || !S_ISSOCK(st.st_mode)) return;
+
+	int fd = socket(AF_UNIX, type, 0);
+	if(fd<0) return;
+	if(connect(fd, addr, addr_len) && errno==ECONNREFUSED)
+		unlink(un->sun_path);
+	close(fd);
+}
+#endif
+
 int csocket_listen(csocket_t *src_socket, int maxQueue) {
 	if(!src_socket || src_socket->mode.sc!=1) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 	
 	if(src_socket->type != SOCK_STREAM && src_socket->type != SOCK_SEQPACKET) {
-		strcpy(src_socket->last_err, "invalid type");
+		_csError(src_socket, CSERR_TYPE);
 		return -1;
 	}
 	if(listen(src_socket->mode.fd, maxQueue) < 0) {
-		strcpy(src_socket->last_err, "listen");
+		_csError(src_socket, CSERR_LISTEN);
 		return -1;
 	}
 	return 0;
 }
 
+int csocket_setFastOpen(csocket_t *src_socket, int qlen) {
+	if(!src_socket || src_socket->mode.sc!=1) return -1;
+	src_socket->err = CSERR_NONE;
+
+	if(src_socket->type != SOCK_STREAM) {
+		_csError(src_socket, CSERR_TYPE);
+		return -1;
+	}
+	#ifdef TCP_FASTOPEN
+		if(setsockopt(src_socket->mode.fd, IPPROTO_TCP, TCP_FASTOPEN, 
+		#ifdef _WIN32 
+			(char*)
+		#endif
+		&qlen, sizeof(qlen))) {
+			_csError(src_socket, CSERR_SOCKOPT);
+			return -1;
+		}
+		return 0;
+	#else
+		(void)qlen;
+		errno = ENOPROTOOPT;
+		_csError(src_socket, CSERR_SOCKOPT);
+		return -1;
+	#endif
+}
+
 /*
 	ONE CLIENT AT A TIME
 */
 
 int csocket_accept(csocket_t *src_socket, csocket_activity_t *activity) {
 	if(!src_socket || !activity || src_socket->mode.sc!=1) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
-	// free activity, just in case
+	// reset activity, just in case (the address buffer and keepalive of a previous client and the counters are reused)
+	struct sockaddr *addr = activity->client_socket.addr;
+	activity->client_socket.addr = NULL;
+	csocket_keepalive_t *ka = activity->client_socket.ka;
+	csocket_stats_t *stats = activity->client_socket.stats;
 	csocket_freeActivity(activity);
+	activity->client_socket.addr = addr;
+	if(ka!=src_socket->ka)
+		activity->client_socket.ka = ka;
+	activity->client_socket.stats = stats;
 
 	// keepalive
 	if(csocket_keepalive_copy(&activity->client_socket.ka, src_socket->ka)) return -1;
 
 	struct csocket_server server = *((struct csocket_server*)&src_socket->mode);
 
-	activity->client_socket.connection_time = time(NULL);
-
-	// update size
-	if(src_socket->domain == AF_INET)
-		activity->client_socket.addr_len = sizeof(struct sockaddr_in);
-	else
-		activity->client_socket.addr_len = sizeof(struct sockaddr_in6);
-
-	if(activity->client_socket.addr)
-		free(activity->client_socket.addr);
-	activity->client_socket.addr = calloc(1, activity->client_socket.addr_len);
+	activity->client_socket.connection_time = _csTime();
+	activity->client_socket.timeout = src_socket->timeout;
 
+	// address buffer fits every domain, allocated on the first accept and kept
+	socklen_t addr_size = sizeof(struct sockaddr_storage);
 	if(!activity->client_socket.addr) {
-		strcpy(src_socket->last_err, "calloc");
-		return -1;
+		activity->client_socket.addr = _csCalloc(NULL, 1, addr_size);
+		if(!activity->client_socket.addr) {
+			_csError(src_socket, CSERR_ALLOC);
+			return -1;
+		}
 	}
+	activity->client_socket.addr_len = addr_size;
 
 	// accept
 	if((server.client_fd = accept(server.server_fd, activity->client_socket.addr, &activity->client_socket.addr_len)) < 0 ) {
-		strcpy(src_socket->last_err, "accept");
+		_csError(src_socket, CSERR_ACCEPT);
 		return -1;
 	}
+	CS_PROBE2(accept, server.client_fd, -1);
 
-	if(activity->client_socket.addr_len == sizeof(struct sockaddr_in))
-		activity->client_socket.domain = AF_INET;
-	else if(activity->client_socket.addr_len == sizeof(struct sockaddr_in6))
-		activity->client_socket.domain = AF_INET6;
-	else
-		activity->client_socket.domain = -1;
+	activity->client_socket.domain = _peerDomain(activity->client_socket.addr, activity->client_socket.addr_len, addr_size);
 	activity->type = CSACT_TYPE_CONN;
 	activity->client_socket.fd = server.client_fd;
 
+	if(activity->client_socket.ka && activity->client_socket.ka->enabled && activity->client_socket.ka->mode==CSKA_MODE_KERNEL)
+		_setKernelKeepAlive(activity->client_socket.fd, activity->client_socket.ka->timeout);
+
 	if(activity->client_socket.ka) {
+		activity->client_socket.ka->stats = activity->client_socket.stats;
 		activity->client_socket.ka->fd = activity->client_socket.fd;
 		activity->client_socket.ka->address.domain = activity->client_socket.domain;
 		activity->client_socket.ka->address.addr = activity->client_socket.addr;
@@ -1146,35 +1791,28 @@ int csocket_accept(csocket_t *src_socket, csocket_activity_t *activity) {
 	}
 
 	// set time
-	activity->time = time(NULL);
+	activity->time = _csTime();
 	activity->update_time = activity->time;
+	activity->ts = *_csNow();
 
 	// poll action
-	fd_set wr, rd, ex;
-	FD_ZERO(&wr);
-	FD_ZERO(&rd);
-	FD_ZERO(&ex);
-	FD_SET(activity->client_socket.fd, &wr);
-	FD_SET(activity->client_socket.fd, &rd);
-	FD_SET(activity->client_socket.fd, &ex);
-
-	struct timeval TIMEVAL_ZERO = {0};
-	int ret = select(activity->client_socket.fd+1, &rd, &wr, &ex, &TIMEVAL_ZERO);
+	int ret = _pollNow(activity->client_socket.fd, POLLIN|POLLOUT|CS_POLLEX);
 	if(ret < 0) {
-		strcpy(src_socket->last_err, "accept");
+		_csError(src_socket, CSERR_ACCEPT);
 		return -1;
 	}
-	if(FD_ISSET(activity->client_socket.fd, &wr))
+	if(ret&(POLLOUT|POLLERR))
 		activity->type |= CSACT_TYPE_WRITE;
-	if(FD_ISSET(activity->client_socket.fd, &rd))
+	if(ret&(POLLIN|POLLHUP|POLLERR))
 		activity->type |= CSACT_TYPE_READ;
 	if((!csocket_hasRecvDataA(activity) && !csocket_hasRecvFromDataA(activity)))
 		activity->type &= ~CSACT_TYPE_READ;
-	if(FD_ISSET(activity->client_socket.fd, &ex))
+	if(ret&CS_POLLEX)
 		activity->type |= CSACT_TYPE_EXT;
 
 	// set after calling the update function
-	activity->client_socket.ka->connection_time = activity->client_socket.connection_time;
+	if(activity->client_socket.ka)
+		activity->client_socket.ka->connection_time = activity->client_socket.connection_time;
 
 	return 0;
 }
@@ -1185,31 +1823,100 @@ int csocket_accept(csocket_t *src_socket, csocket_activity_t *activity) {
 // handling all clients - should be called in a while(true)
 int csocket_setUpMultiServer(csocket_t *src_socket, int maxClient, void (*onActivity)(csocket_multiHandler_t *, csocket_activity_t), csocket_multiHandler_t *handler) {
 	if(!src_socket || !handler || src_socket->mode.sc!=1) return -1;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 	
-	// free handler, just in case
+	// free handler, just in case (the allocator is kept)
+	csocket_allocator_t allocator = handler->allocator;
 	csocket_freeMultiHandler(handler);
+	handler->allocator = allocator;
 
 	handler->src_socket = src_socket;
 	handler->onActivity = onActivity;
 	if(maxClient<1) {
-		strcpy(src_socket->last_err, "multiServer maxClient<1");
+		_csError(src_socket, CSERR_INVAL);
 		return -1;
 	} 
 	handler->maxClients = maxClient;
 
-	handler->client_sockets = calloc(maxClient, sizeof(struct csocket_clients));
-	if(!handler->client_sockets) {
-		strcpy(src_socket->last_err, "multiServer calloc");
+	handler->activities = _csCalloc(&handler->allocator, maxClient, sizeof(csocket_activity_t));
+	// three spare entries for the metrics listener, the scrape and the handoff channel
+	handler->pfds = _csCalloc(&handler->allocator, maxClient+4, sizeof(struct pollfd));
+	if(!handler->activities || !handler->pfds) {
+		_csError(src_socket, CSERR_ALLOC);
 		return -1;
 	}
+	if(_slabInit(&handler->slab, maxClient, &handler->allocator)) {
+		_csError(src_socket, CSERR_ALLOC);
+		return -1;
+	}
+
+	return 0;
+}
+
+int csocket_setUpMultiServer2(csocket_t *src_socket, int maxClient, void (*onActivity2)(csocket_multiHandler_t *, csocket_activity_t *), void *user, csocket_multiHandler_t *handler) {
+	if(csocket_setUpMultiServer(src_socket, maxClient, NULL, handler)) return -1;
+
+	handler->onActivity2 = onActivity2;
+	handler->user = user;
 
 	return 0;
 }
 
 int csocket_multiServer(csocket_multiHandler_t *handler) {
+	return _runMultiServer(handler, -1);
+}
+
+static int _runMultiServer(csocket_multiHandler_t *handler, int polled) {
+	unsigned long long start = handler && (handler->hist || handler->metrics)?_histClock():0;
+
+	// loop lag: time since the last iteration that was not spent waiting for events
+	if(start && handler->metrics) {
+		csocket_metrics_t *metrics = handler->metrics;
+		if(metrics->loop_last && start-metrics->loop_last>metrics->loop_gap)
+			metrics->loop_gap = start-metrics->loop_last;
+	}
+
+	// one clock sample for the whole iteration
+	_csClockBegin();
+	int res = _multiServer(handler, polled);
+	_csClockEnd();
+
+	unsigned long long end = start?_histClock():0;
+	if(start && handler->hist)
+		csocket_histogram_record(&handler->hist[CSHIST_LOOP], end-start);
+	if(start && handler->metrics)
+		handler->metrics->loop_last = end;
+	return res;
+}
+
+int csocket_multiServerWait(csocket_multiHandler_t *handler, const struct timespec *timeout) {
+	if(!handler || !handler->pfds || !handler->src_socket || handler->src_socket->mode.sc!=1) return -1;
+
+	// round up, never wake before the timeout
+	int wait_ms = -1;
+	if(timeout) {
+		long long ns = (long long)timeout->tv_sec*1000000000LL+timeout->tv_nsec;
+		wait_ms = ns>0?(int)(ns/1000000LL+(ns%1000000LL?1:0)):0;
+	}
+
+	// sleep on the whole poll set outside of the iteration, so it does not count as loop time
+	int npfds = _pollSet(handler);
+	#ifdef _WIN32
+		int polled = WSAPoll(handler->pfds, npfds, wait_ms);
+	#else
+		int polled = poll(handler->pfds, npfds, wait_ms);
+	#endif
+	// the sleep is no loop lag
+	if(handler->metrics)
+		handler->metrics->loop_last = _histClock();
+
+	// the iteration works on these events, interrupted waits poll again
+	return _runMultiServer(handler, polled);
+}
+
+static int _multiServer(csocket_multiHandler_t *handler, int polled) {
 	if(!handler || handler->src_socket->mode.sc!=1) return -1;
-	strcpy(handler->src_socket->last_err, ""); 
+	handler->src_socket->err = CSERR_NONE; 
 
 	/**
 	 * 1. SET FDS
@@ -1220,359 +1927,2039 @@ int csocket_multiServer(csocket_multiHandler_t *handler) {
 
 	struct csocket_server server= *((struct csocket_server*)&handler->src_socket->mode);
 
-	int maxfd = server.server_fd;
-
-	fd_set rd;
-	FD_ZERO(&rd);
-	FD_SET(server.server_fd, &rd);
-
-	// add other clients
-	for(int i=0; i<handler->maxClients; ++i) {
-		if(handler->client_sockets[i].fd>0) {
-			FD_SET(handler->client_sockets[i].fd, &rd);
-		}
-		maxfd = handler->client_sockets[i].fd>maxfd?handler->client_sockets[i].fd:maxfd;
+	struct pollfd *pfds = handler->pfds;
+	if(polled<0) {
+		int npfds = _pollSet(handler);
+		#ifdef _WIN32
+			polled = WSAPoll(pfds, npfds, 0);
+		#else
+			polled = poll(pfds, npfds, 0);
+		#endif
 	}
-	struct timeval TIMEVAL_ZERO = {0};
-	if(select(maxfd+1, &rd, NULL, NULL, &TIMEVAL_ZERO)<0) {
+	if(polled<0) {
 		return 0;
 	}
+	if(handler->hist)
+		handler->hist_ready = _histClock();
 
 	/*
-		HANDLE SELECTED EVENTS
+		HANDLE POLLED EVENTS
 	*/
 
 	// action on server.server_fd -> new client
-	if(FD_ISSET(server.server_fd, &rd)) {
-
-		// new client
-		struct csocket_clients client = CSOCKET_EMPTY;
-		if(csocket_keepalive_copy(&client.ka, handler->src_socket->ka)) return -1;
-		// set size
-		if(handler->src_socket->domain == AF_INET)
-			client.addr_len = sizeof(struct sockaddr_in);
-		else
-			client.addr_len = sizeof(struct sockaddr_in6);
-		
-		// alloc address
-		client.addr = calloc(1, client.addr_len);
+	if((pfds[0].revents&POLLIN) && _acceptClient(handler, server.server_fd))
+		return -1;
 
-		if(!client.addr) {
-			strcpy(handler->src_socket->last_err, "multiServer calloc");
-			return -1;
-		}
-	
-		// accept
-		if((server.client_fd = accept(server.server_fd, client.addr, &client.addr_len)) < 0 ) {
-			free(client.addr);
-			strcpy(handler->src_socket->last_err, "multiServer accept");
-			return -1;
+	// clients handed over by other processes
+	if(handler->handoff>0 && (pfds[handler->maxClients+3].revents&(POLLIN|POLLHUP))) {
+		// at most one per slot and iteration, the rest stays queued in the channel
+		for(int n=0; n<=handler->maxClients; ++n) {
+			int res = csocket_adoptClient(handler, handler->handoff);
+			if(res<0) return -1;
+			if(res==0) break;
 		}
+	}
 
-		/**
-		 * 
-		 * FORM ACTIVITY AND CLIENT
-		 * 
-		**/
-		client.fd = server.client_fd;
-		client.connection_time = time(NULL);
-		
-		// verify size and set domain
-		if(client.addr_len == sizeof(struct sockaddr_in))
-			client.domain = AF_INET;
-		else if(client.addr_len == sizeof(struct sockaddr_in6))
-			client.domain = AF_INET6;
-		else
-			client.domain = -1;
-
-		client.ka->fd = client.fd;
-		client.ka->address.domain = client.domain;
-		client.ka->address.addr = client.addr;
-		client.ka->address.addr_len = client.addr_len;
-	
-		
-		// set activity
-		csocket_activity_t activity = CSOCKET_EMPTY;
-		activity.client_socket = client;
-		activity.type = CSACT_TYPE_CONN | CSACT_TYPE_DECLINED;
-
-		// set time
-		activity.time = time(NULL);
-		activity.update_time = activity.time;
-
-		// poll action
-		fd_set wr2, rd2, ex2;
-		FD_ZERO(&wr2);
-		FD_ZERO(&rd2);
-		FD_ZERO(&ex2);
-		FD_SET(activity.client_socket.fd, &wr2);
-		FD_SET(activity.client_socket.fd, &rd2);
-		FD_SET(activity.client_socket.fd, &ex2);
-		struct timeval TIMEVAL_ZERO = {0};
-		int ret = select(activity.client_socket.fd+1, &rd2, &wr2, &ex2, &TIMEVAL_ZERO);
-		if(ret < 0) {
-			strcpy(handler->src_socket->last_err, "multiServer accept");
-			return -1;
+	// action on any socket
+	for(int i=0; i<handler->maxClients; ++i) {
+		// stable activity of the client, changes by the handler stay in the table
+		csocket_activity_t *activity = &handler->activities[i];
+		struct csocket_clients *client = &activity->client_socket;
+		if(client->fd<=0) continue;
+
+		// handed off, the connection stays open in the other process
+		if(client->handoff) {
+			_statAdd(&handler->stats, &handler->slab.slots[i].stats);
+			_closeFd(client->fd);
+			*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+			_slabRelease(&handler->slab, i);
+			continue;
 		}
-		if(FD_ISSET(activity.client_socket.fd, &wr2))
-			activity.type |= CSACT_TYPE_WRITE;
-		if(FD_ISSET(activity.client_socket.fd, &rd2))
-			activity.type |= CSACT_TYPE_READ;
-		if((!csocket_hasRecvDataA(&activity) && !csocket_hasRecvFromDataA(&activity)))
-			activity.type &= ~CSACT_TYPE_READ;
-		if(FD_ISSET(activity.client_socket.fd, &ex2))
-			activity.type |= CSACT_TYPE_EXT;
-
-		// set after calling the update function
-		client.ka->connection_time = client.connection_time;
 
-		// add to list
-		for(int i=0; i<handler->maxClients; ++i) {
-			if(handler->client_sockets[i].fd == 0) {
-				handler->client_sockets[i] = client;
-				activity.type &= ~CSACT_TYPE_DECLINED;
-				break;
-			}
+		// outbound connect in progress
+		if(client->connecting) {
+			_updateConnect(handler, i, pfds[i+1].revents);
+			continue;
 		}
 
-		// trigger action
-		if(handler->onActivity)
-			handler->onActivity(handler, activity);
-	}
-
-	// action on any socket
-	for(int i=0; i<handler->maxClients; ++i) {
-		// client
-		struct csocket_clients client = handler->client_sockets[i];
+		int fdset = (pfds[i+1].revents&(POLLIN|POLLHUP|POLLERR))!=0;
 
-		int fdset = FD_ISSET(client.fd, &rd);
+		// connection-oriented only, the From variants are not needed here
+		csocket_updateKeepAlive(client->ka, client->fd);
 
-		csocket_updateKeepAlive(client.ka, client.fd);
-		csocket_addr_t kaadr;
-		kaadr.domain = client.domain;
-		kaadr.addr = client.addr;
-		kaadr.addr_len = client.addr_len;
-		csocket_updateKeepAliveFrom(client.ka, client.fd, &kaadr);
+		fdset |= _hasRecvDataBuffer(client->ka, client->fd)==1;
 
-		fdset |= _hasRecvDataBuffer(client.ka, client.fd)==1||_hasRecvFromDataBuffer(client.ka, client.fd, client.addr, &client.addr_len)==1;
+		// kernel keepalive: errors and EOF show up as readable
+		if(fdset && client->ka && client->ka->enabled && client->ka->mode==CSKA_MODE_KERNEL)
+			_updateKernelKeepAlive(client->ka, client->fd);
 
-		if(fdset||!csocket_isAlive(client.ka)||client.shutdown) {
+		if(fdset||!csocket_isAlive(client->ka)||client->shutdown) {
 
 			/**
 			 * 
 			 * FORM ACTIVITY
 			 * 
 			**/
-			csocket_activity_t activity = CSOCKET_EMPTY;
-			activity.client_socket = client;
+			activity->type = 0;
 
 			// set time
-			activity.time = time(NULL);
-			activity.update_time = activity.time;
+			activity->time = _csTime();
+			activity->update_time = activity->time;
+			activity->ts = *_csNow();
 				
 			// disconnect
 			// DGRAMs allow 0 width data -> recv = 0
 			// options: 1) manual shutdown by user 2) timeout
 
 			// no data: disconnected
-			if(csocket_isAlive(activity.client_socket.ka)==0 || client.shutdown) {
+			if(csocket_isAlive(client->ka)==0 || client->shutdown) {
 
-				activity.type = CSACT_TYPE_DISCONN;
+				activity->type = CSACT_TYPE_DISCONN;
+				if(!client->shutdown) {
+					CS_PROBE2(ka__timeout, client->fd, i);
+					if(handler->metrics)
+						++handler->metrics->ka_timeouts;
+				}
+				CS_PROBE2(disconnect, client->fd, i);
 				
-				shutdown(client.fd, SHUT_RDWR);
+				shutdown(client->fd, SHUT_RDWR);
 				
 				// trigger action
-				if(handler->onActivity) {
-					handler->onActivity(handler, activity);
-					handler->client_sockets[i] = (const struct csocket_clients)CSOCKET_EMPTY;
-					client.ka = handler->src_socket->ka;
-				}
-				else {
-					// free
-					csocket_freeActivity(&activity);
-					// write addr = NULL to prevent duplicate free
-					handler->client_sockets[i].addr = NULL;
-					csocket_freeClients(&handler->client_sockets[i]);
-				}
+				_dispatchActivity(handler, activity);
+
+				// return client state to the slab
+				_statAdd(&handler->stats, &handler->slab.slots[i].stats);
+				_closeFd(client->fd);
+				*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+				_slabRelease(&handler->slab, i);
 			}
 			else {
 
 				// poll action
-				fd_set wr2, ex2;
-				FD_ZERO(&wr2);
-				FD_ZERO(&ex2);
-				FD_SET(activity.client_socket.fd, &wr2);
-				FD_SET(activity.client_socket.fd, &ex2);
-				struct timeval TIMEVAL_ZERO = {0};
-				int ret = select(activity.client_socket.fd+1, NULL, &wr2, &ex2, &TIMEVAL_ZERO);
+				int ret = _pollNow(client->fd, POLLOUT|CS_POLLEX);
 				if(ret < 0) {
-					strcpy(handler->src_socket->last_err, "multiServer socketchange");
+					_csError(handler->src_socket, CSERR_POLL);
 					return -1;
 				}
-				if(FD_ISSET(activity.client_socket.fd, &wr2))
-					activity.type |= CSACT_TYPE_WRITE;
+				if(ret&(POLLOUT|POLLERR))
+					activity->type |= CSACT_TYPE_WRITE;
 				if(fdset)
-					activity.type |= CSACT_TYPE_READ;
-				if(FD_ISSET(activity.client_socket.fd, &ex2))
-					activity.type |= CSACT_TYPE_EXT;
+					activity->type |= CSACT_TYPE_READ;
+				if(ret&CS_POLLEX)
+					activity->type |= CSACT_TYPE_EXT;
 
 				// trigger action on data
-				if((csocket_hasRecvDataA(&activity)==1 || csocket_hasRecvFromDataA(&activity)==1) && handler->onActivity)
-					handler->onActivity(handler, activity);
+				if(csocket_hasRecvDataA(activity)==1) {
+					struct csocket_framer *framer = &handler->slab.slots[i].framer;
+					if(framer->type!=CSFRM_TYPE_NONE && handler->onMessage) {
+						// protocol violation
+						if(_readMessages(handler, activity, framer))
+							client->shutdown = 1;
+					}
+					else
+						_dispatchActivity(handler, activity);
+				}
+				// readable without data: the peer closed the connection, disconnect on the next iteration
+				else if(fdset && handler->src_socket->type!=SOCK_DGRAM && _statRecv(client->stats, recv(client->fd, &(char){0}, 1, MSG_PEEK|MSG_DONTWAIT), MSG_PEEK)==0)
+					client->shutdown = 1;
 			}
 		}
 	}
 
+	if(handler->metrics)
+		_updateMetrics(handler, pfds[handler->maxClients+1].revents, pfds[handler->maxClients+2].revents);
+
 	return 0;
 }
 
-int csocket_shutdownClient(csocket_multiHandler_t *handler, struct csocket_clients *client) {
-	if(!handler) return -1;
-	strcpy(handler->src_socket->last_err, "");
-
-	int n = 0;
+// poll set: server first, then one entry per client slot, metrics and handoff last, returns the number of entries
+static int _pollSet(csocket_multiHandler_t *handler) {
+	struct pollfd *pfds = handler->pfds;
+	pfds[0].fd = handler->src_socket->mode.fd;
+	pfds[0].events = POLLIN;
+	pfds[0].revents = 0;
 
+	// add other clients, outbound connects wait for writability
 	for(int i=0; i<handler->maxClients; ++i) {
-		if(handler->client_sockets[i].fd>0 && (!client || handler->client_sockets[i].fd==client->fd)) {
-			handler->client_sockets[i].shutdown = 1;
-			if(client) client->shutdown = 1;
-			n++;
+		struct csocket_clients *client = &handler->activities[i].client_socket;
+		pfds[i+1].fd = client->fd>0 && !client->handoff?client->fd:-1;
+		pfds[i+1].events = client->connecting?POLLOUT:POLLIN;
+		pfds[i+1].revents = 0;
+	}
+	// metrics listener and scrape, then the handoff channel
+	int npfds = handler->maxClients+1;
+	if(handler->metrics || handler->handoff>0) {
+		pfds[npfds].fd = handler->metrics?handler->metrics->fd:-1;
+		pfds[npfds+1].fd = handler->metrics?handler->metrics->conn:-1;
+		pfds[npfds+2].fd = handler->handoff>0?handler->handoff:-1;
+		for(int i=npfds; i<npfds+3; ++i) {
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
 		}
+		npfds += 3;
 	}
-	
-	return n;
+
+	return npfds;
 }
 
-#pragma endregion
+static void _dispatchActivity(csocket_multiHandler_t *handler, csocket_activity_t *activity) {
+	int accepted = (activity->type&CSACT_TYPE_CONN)!=0;
+	unsigned long long start = _histBegin(handler, accepted?CSHIST_ACCEPT:CSHIST_DISPATCH, accepted?handler->hist_accept:handler->hist_ready);
+	int fd = activity->client_socket.fd, type = activity->type;
+	CS_PROBE3(callback__enter, fd, type, 0);
 
-#pragma region CLIENT
+	if(handler->onActivity2)
+		handler->onActivity2(handler, activity);
+	else if(handler->onActivity)
+		handler->onActivity(handler, *activity);
 
-int csocket_connectClient(csocket_t *src_socket, struct timeval *timeout) {
-	if(!src_socket || src_socket->mode.sc!=2) return -1;
-	strcpy(src_socket->last_err, "");
+	CS_PROBE2(callback__exit, fd, type);
+	_histEnd(handler, start);
+}
 
-	struct csocket_client client = *((struct csocket_client*)&src_socket->mode);
-	
-	// disable block
-	#ifdef _WIN32
-		{
-			u_long iMode = 0;
-			ioctlsocket(client.client_fd, FIONBIO, &iMode);
-		}
-	#else
-		fcntl(client.client_fd, F_SETFL, O_NONBLOCK);
-	#endif
-	
-	// connect
-	if(connect(client.client_fd, client.addr, client.addr_len) == -1) {
-		if(errno != CS_EINPROGRESS) {
-			strcpy(src_socket->last_err, "connect err");
-			return -1;
+static void _dispatchMessage(csocket_multiHandler_t *handler, csocket_activity_t *activity, const char *msg, size_t len) {
+	unsigned long long start = _histBegin(handler, CSHIST_DISPATCH, handler->hist_ready);
+	if(activity->client_socket.stats)
+		++activity->client_socket.stats->messages;
+	int fd = activity->client_socket.fd, type = activity->type;
+	CS_PROBE3(callback__enter, fd, type, len);
+	handler->onMessage(handler, activity, msg, len);
+	CS_PROBE2(callback__exit, fd, type);
+	_histEnd(handler, start);
+}
+
+// accept one client on server_fd, dispatches CSACT_TYPE_CONN
+static int _acceptClient(csocket_multiHandler_t *handler, int server_fd) {
+
+	// new client, state is carved from the slab
+	struct csocket_clients client = CSOCKET_EMPTY;
+	struct sockaddr_storage declined_addr;
+	int slot = _slabAlloc(&handler->slab);
+	if(slot>=0) {
+		client.addr = (struct sockaddr*)&handler->slab.slots[slot].addr;
+		client.stats = &handler->slab.slots[slot].stats;
+		if(handler->src_socket->ka) {
+			client.ka = &handler->slab.slots[slot].ka;
+			if(_keepaliveCopy(client.ka, handler->src_socket->ka, &handler->allocator)) {
+				_slabRelease(&handler->slab, slot);
+				_csError(handler->src_socket, CSERR_ALLOC);
+				return -1;
+			}
+			client.ka->stats = client.stats;
 		}
 	}
-	// verify connection
-	fd_set wr, rd;
-	FD_ZERO(&wr);
-	FD_ZERO(&rd);
-	FD_SET(client.client_fd, &wr);
-	FD_SET(client.client_fd, &rd);
-	int ret = select(client.client_fd+1, &rd, &wr, NULL, timeout);
-	if(ret == 0) {
-		strcpy(src_socket->last_err, "connect timeout");
-		return -1;
+	else {
+		// no slot left, accept anyway and decline
+		client.addr = (struct sockaddr*)&declined_addr;
 	}
-	if(ret < 0) {
-		strcpy(src_socket->last_err, "connect err");
+	client.addr_len = sizeof(struct sockaddr_storage);
+	client.timeout = handler->src_socket->timeout;
+
+	// accept
+	if(handler->hist)
+		handler->hist_accept = _histClock();
+	int client_fd = accept(server_fd, client.addr, &client.addr_len);
+	if(client_fd<0) {
+		_slabRelease(&handler->slab, slot);
+		// shared listener (csocket_prefork_create), another process was faster
+		if(errno==EAGAIN || errno==EWOULDBLOCK)
+			return 0;
+		_csError(handler->src_socket, CSERR_ACCEPT);
 		return -1;
 	}
-	#ifdef _WIN32
-		char
-	#else 
-		int
-	#endif 
-		err = 1;
-	socklen_t len = sizeof(int);
-	if((!FD_ISSET(client.client_fd, &rd)&&!FD_ISSET(client.client_fd, &wr)) || getsockopt(client.client_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
-		strcpy(src_socket->last_err, "connect none");
-		return -1;
+	#if !defined(__linux__) && !defined(_WIN32)
+		// accepted sockets inherit O_NONBLOCK of a shared listener on BSDs
+		_setNonBlock(client_fd, 0);
+	#endif
+	CS_PROBE2(accept, client_fd, slot);
+	if(handler->metrics) {
+		if(slot>=0)
+			++handler->metrics->accepted;
+		else
+			++handler->metrics->declined;
 	}
 
-	#ifdef _WIN32
-		{
-			u_long iMode = 0;
-			ioctlsocket(client.client_fd, FIONBIO, &iMode);
-		}
-	#else
-		// enable block
-		int flg = fcntl(client.client_fd, F_GETFL);
-		if(flg!=-1)
-			fcntl(client.client_fd, F_SETFL, flg & ~O_NONBLOCK);
-	#endif
+	/**
+	 * 
+	 * FORM ACTIVITY AND CLIENT
+	 * 
+	**/
+	client.fd = client_fd;
+	client.connection_time = _csTime();
+	
+	// verify size and set domain
+	client.domain = _peerDomain(client.addr, client.addr_len, sizeof(struct sockaddr_storage));
 
-	return -(err != 0);
-}
+	if(client.ka && client.ka->enabled && client.ka->mode==CSKA_MODE_KERNEL)
+		_setKernelKeepAlive(client.fd, client.ka->timeout);
 
-#pragma endregion
+	if(client.ka) {
+		client.ka->fd = client.fd;
+		client.ka->address.domain = client.domain;
+		client.ka->address.addr = client.addr;
+		client.ka->address.addr_len = client.addr_len;
+	}
 
-#pragma region UTIL
+	if(_admitClient(handler, slot, &client)) {
+		_csError(handler->src_socket, CSERR_ACCEPT);
+		return -1;
+	}
 
-const char * csocket_ntop(int domain, const void *addr, char *dst, socklen_t len) {
-	return inet_ntop(domain, domain==AF_INET?(void*)&(((struct sockaddr_in*)addr)->sin_addr):(void*)&(((struct sockaddr_in6*)addr)->sin6_addr), dst, len);
+	return 0;
 }
 
-#pragma endregion
+// new client (accepted or adopted), dispatches CSACT_TYPE_CONN and keeps the client in slot, declines it without a slot
+static int _admitClient(csocket_multiHandler_t *handler, int slot, struct csocket_clients *client) {
+	// set activity
+	csocket_activity_t activity = CSOCKET_EMPTY;
+	activity.client_socket = *client;
+	activity.type = CSACT_TYPE_CONN | CSACT_TYPE_DECLINED;
 
-#pragma region FREE
+	// set time
+	activity.time = _csTime();
+	activity.update_time = activity.time;
+	activity.ts = *_csNow();
 
-// free
-void csocket_free(csocket_t *src_socket) {
-	if(!src_socket) return;
-	strcpy(src_socket->last_err, "");
-	
-	// free
-	if(src_socket->mode.sc>0&&src_socket->mode.addr) {
-		free(src_socket->mode.addr);
-		src_socket->mode.addr = NULL;
+	// poll action
+	int ret = _pollNow(activity.client_socket.fd, POLLIN|POLLOUT|CS_POLLEX);
+	if(ret < 0) {
+		_closeFd(client->fd);
+		_slabRelease(&handler->slab, slot);
+		return -1;
 	}
+	if(ret&(POLLOUT|POLLERR))
+		activity.type |= CSACT_TYPE_WRITE;
+	if(ret&(POLLIN|POLLHUP|POLLERR))
+		activity.type |= CSACT_TYPE_READ;
+	if(!csocket_hasRecvDataA(&activity))
+		activity.type &= ~CSACT_TYPE_READ;
+	if(ret&CS_POLLEX)
+		activity.type |= CSACT_TYPE_EXT;
 
-	// close fd
-	if(src_socket->mode.fd>=0)
-		shutdown(src_socket->mode.fd, SHUT_RDWR);
-	if(src_socket->mode.sc==1&&((struct csocket_server*)&src_socket->mode)->client_fd>=0)
-		shutdown(((struct csocket_server*)&src_socket->mode)->client_fd, SHUT_RDWR);
+	// set after calling the update function
+	if(client->ka)
+		client->ka->connection_time = client->connection_time;
 
-	csocket_freeKeepalive(src_socket->ka);
-	
-	// reset
-	*src_socket = (const csocket_t)CSOCKET_EMPTY;
-}
+	// add to list
+	if(slot>=0) {
+		activity.type &= ~CSACT_TYPE_DECLINED;
+		handler->activities[slot] = activity;
 
-void csocket_freeActivity(csocket_activity_t *activity) {
-	if(!activity) return;
+		struct csocket_framer *framer = &handler->slab.slots[slot].framer;
+		framer->type = handler->framing.type;
+		framer->param = handler->framing.param;
+		framer->max_len = handler->framing.max_len;
 
-	// free
-	if(activity->client_socket.addr) {
-		free(activity->client_socket.addr);
-		activity->client_socket.addr = NULL;
+		// trigger action
+		_dispatchActivity(handler, &handler->activities[slot]);
 	}
+	else {
+		// trigger action
+		_dispatchActivity(handler, &activity);
 
-	// close fd
-	if(activity->client_socket.fd>=0)
-		shutdown(activity->client_socket.fd, SHUT_RDWR);
-	// reset
-	*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+		// declined clients are not kept
+		shutdown(client->fd, SHUT_RDWR);
+		_closeFd(client->fd);
+	}
+
+	return 0;
 }
 
-void csocket_freeMultiHandler(csocket_multiHandler_t *handler) {
-	if(!handler) return;
+int csocket_connectAsync(csocket_multiHandler_t *handler, const csocket_addr_t *dst, void *user) {
+	if(!handler || !handler->activities || !dst || !dst->addr) return -1;
+	if(dst->addr_len<=0 || (size_t)dst->addr_len>sizeof(struct sockaddr_storage)) return -1;
+	handler->src_socket->err = CSERR_NONE;
 
-	// free
-	if(handler->client_sockets) {
-		free(handler->client_sockets);
-		handler->client_sockets = NULL;
+	// outbound clients share the slots of accepted clients
+	int slot = _slabAlloc(&handler->slab);
+	if(slot<0) {
+		errno = EBUSY;
+		_csError(handler->src_socket, CSERR_ALLOC);
+		return -1;
 	}
+	struct csocket_slot *state = &handler->slab.slots[slot];
 
-	// reset
+	int fd = socket(dst->addr->sa_family, handler->src_socket->type, handler->src_socket->protocol);
+	if(fd<0) {
+		_slabRelease(&handler->slab, slot);
+		_csError(handler->src_socket, CSERR_SOCKET);
+		return -1;
+	}
+	_setNonBlock(fd, 1);
+	if(connect(fd, dst->addr, dst->addr_len)!=0 && errno!=CS_EINPROGRESS && errno!=EWOULDBLOCK) {
+		_csError(handler->src_socket, CSERR_CONNECT);
+		_closeFd(fd);
+		_slabRelease(&handler->slab, slot);
+		return -1;
+	}
+
+	struct csocket_clients client = CSOCKET_EMPTY;
+	memcpy(&state->addr, dst->addr, dst->addr_len);
+	client.addr = (struct sockaddr*)&state->addr;
+	client.addr_len = dst->addr_len;
+	client.domain = dst->addr->sa_family;
+	client.fd = fd;
+	client.user = user;
+	client.timeout = handler->src_socket->timeout;
+	client.connecting = 1;
+	client.stats = &state->stats;
+	if(handler->src_socket->ka) {
+		client.ka = &state->ka;
+		if(_keepaliveCopy(client.ka, handler->src_socket->ka, &handler->allocator)) {
+			_closeFd(fd);
+			_slabRelease(&handler->slab, slot);
+			_csError(handler->src_socket, CSERR_ALLOC);
+			return -1;
+		}
+		client.ka->stats = client.stats;
+	}
+
+	state->framer.type = handler->framing.type;
+	state->framer.param = handler->framing.param;
+	state->framer.max_len = handler->framing.max_len;
+
+	csocket_activity_t *activity = &handler->activities[slot];
+	*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+	activity->client_socket = client;
+	// start of the connect, for the timeout
+	activity->ts = *_csNow();
+
+	return 0;
+}
+
+// outbound connect: report completion or failure once the socket is writable or the timeout passed
+static void _updateConnect(csocket_multiHandler_t *handler, int slot, short revents) {
+	csocket_activity_t *activity = &handler->activities[slot];
+	struct csocket_clients *client = &activity->client_socket;
+
+	int err = 0;
+	if(revents) {
+		#ifdef _WIN32
+			char
+		#else 
+			int
+		#endif 
+			soerr = 0;
+		socklen_t len = sizeof(soerr);
+		if(getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &soerr, &len)<0)
+			err = errno;
+		else
+			err = soerr;
+		if(!err && !(revents&POLLOUT)) err = ECONNREFUSED;
+	}
+	else {
+		const struct timespec *timeout = _csTimeout(&client->timeout);
+		if(timeout->tv_sec<=0 && timeout->tv_nsec<=0) return;
+		const struct timespec *now = _csNow();
+		long long ns = (long long)(now->tv_sec-activity->ts.tv_sec)*1000000000LL+(now->tv_nsec-activity->ts.tv_nsec);
+		if(ns<(long long)timeout->tv_sec*1000000000LL+timeout->tv_nsec) return;
+		err = ETIMEDOUT;
+	}
+
+	activity->time = _csTime();
+	activity->update_time = activity->time;
+	activity->ts = *_csNow();
+
+	if(err) {
+		activity->type = CSACT_TYPE_CONNFAIL;
+		errno = err;
+		_dispatchActivity(handler, activity);
+
+		_statAdd(&handler->stats, &handler->slab.slots[slot].stats);
+		_closeFd(client->fd);
+		*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+		_slabRelease(&handler->slab, slot);
+		return;
+	}
+
+	// connected, from now on handled like an accepted client
+	_setNonBlock(client->fd, 0);
+	client->connecting = 0;
+	client->connection_time = activity->time;
+	if(client->ka) {
+		if(client->ka->enabled && client->ka->mode==CSKA_MODE_KERNEL)
+			_setKernelKeepAlive(client->fd, client->ka->timeout);
+		client->ka->fd = client->fd;
+		client->ka->address.domain = client->domain;
+		client->ka->address.addr = client->addr;
+		client->ka->address.addr_len = client->addr_len;
+		client->ka->connection_time = client->connection_time;
+		_kaSignal(client->ka);
+	}
+
+	activity->type = CSACT_TYPE_CONNOUT|CSACT_TYPE_WRITE;
+	_dispatchActivity(handler, activity);
+}
+
+int csocket_shutdownClient(csocket_multiHandler_t *handler, struct csocket_clients *client) {
+	if(!handler) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	int n = 0;
+
+	for(int i=0; i<handler->maxClients; ++i) {
+		if(handler->activities[i].client_socket.fd>0 && (!client || handler->activities[i].client_socket.fd==client->fd)) {
+			handler->activities[i].client_socket.shutdown = 1;
+			if(client) client->shutdown = 1;
+			n++;
+		}
+	}
+	
+	return n;
+}
+
+/*
+	FRAMING
+*/
+int csocket_setFraming(csocket_multiHandler_t *handler, struct csocket_clients *client, int type, size_t param, size_t max_len) {
+	if(!handler || !handler->src_socket) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	if(type==CSFRM_TYPE_FIXED)
+		max_len = param;
+	if((type==CSFRM_TYPE_LENGTH && param!=1 && param!=2 && param!=4) ||
+	(type==CSFRM_TYPE_FIXED && param<1) ||
+	(type==CSFRM_TYPE_DELIM && param>0xFF) ||
+	(type!=CSFRM_TYPE_NONE && type!=CSFRM_TYPE_LENGTH && type!=CSFRM_TYPE_FIXED && type!=CSFRM_TYPE_DELIM) ||
+	(type!=CSFRM_TYPE_NONE && max_len<1)) {
+		_csError(handler->src_socket, CSERR_INVAL);
+		return -1;
+	}
+
+	struct csocket_framer *framer = &handler->framing;
+	if(client) {
+		framer = NULL;
+		for(int i=0; i<handler->maxClients; ++i) {
+			if(handler->activities[i].client_socket.fd>0 && handler->activities[i].client_socket.fd==client->fd) {
+				framer = &handler->slab.slots[i].framer;
+				break;
+			}
+		}
+		if(!framer) {
+			_csError(handler->src_socket, CSERR_NOCLIENT);
+			return -1;
+		}
+		// pending bytes are dropped
+		framer->start = 0;
+		framer->usage = 0;
+		framer->scanned = 0;
+	}
+	framer->type = type;
+	framer->param = param;
+	framer->max_len = max_len;
+
+	return 0;
+}
+
+static int _readMessages(csocket_multiHandler_t *handler, csocket_activity_t *activity, struct csocket_framer *framer) {
+	size_t header = framer->type==CSFRM_TYPE_LENGTH?framer->param:0;
+	size_t delim = framer->type==CSFRM_TYPE_DELIM?1:0;
+
+	// buffer holds one complete message, allocated on first use and kept
+	size_t needed = framer->max_len+header+delim;
+	if(framer->buffer_len!=needed) {
+		CS_PROBE3(buffer__grow, activity->client_socket.fd, framer->buffer_len, needed);
+		char *n = _csRealloc(&handler->allocator, framer->buffer, needed);
+		if(!n) return -1;
+		framer->buffer = n;
+		framer->buffer_len = needed;
+		framer->start = 0;
+		framer->usage = 0;
+		framer->scanned = 0;
+	}
+
+	// move a partial message to the front only if the tail is full
+	if(framer->usage==framer->buffer_len && framer->start>0) {
+		memmove(framer->buffer, framer->buffer+framer->start, framer->usage-framer->start);
+		framer->usage -= framer->start;
+		framer->start = 0;
+	}
+	if(framer->usage==framer->buffer_len) return -1;
+
+	ssize_t res = csocket_recvA(activity, framer->buffer+framer->usage, framer->buffer_len-framer->usage, MSG_DONTWAIT);
+	if(res<=0) return 0;
+	framer->usage += res;
+	_statBuffer(activity->client_socket.stats, framer->usage-framer->start);
+
+	// hand out complete messages as views into the buffer
+	while(framer->start<framer->usage) {
+		char *data = framer->buffer+framer->start;
+		size_t avail = framer->usage-framer->start;
+		size_t msg_len = 0;
+
+		if(framer->type==CSFRM_TYPE_LENGTH) {
+			if(avail<header) break;
+			for(size_t b=0; b<header; ++b)
+				msg_len = (msg_len<<8)|(unsigned char)data[b];
+			if(msg_len>framer->max_len) return -1;
+			if(avail<header+msg_len) break;
+			_dispatchMessage(handler, activity, data+header, msg_len);
+			framer->start += header+msg_len;
+		}
+		else if(framer->type==CSFRM_TYPE_FIXED) {
+			if(avail<framer->param) break;
+			_dispatchMessage(handler, activity, data, framer->param);
+			framer->start += framer->param;
+		}
+		else {
+			char *end = memchr(data+framer->scanned, (int)framer->param, avail-framer->scanned);
+			if(!end) {
+				if(avail>framer->max_len) return -1;
+				framer->scanned = avail;
+				break;
+			}
+			msg_len = end-data;
+			if(msg_len>framer->max_len) return -1;
+			_dispatchMessage(handler, activity, data, msg_len);
+			framer->start += msg_len+1;
+			framer->scanned = 0;
+		}
+	}
+
+	// everything consumed, start over without copying
+	if(framer->start==framer->usage) {
+		framer->start = 0;
+		framer->usage = 0;
+	}
+
+	return 0;
+}
+
+static void _freeFramer(struct csocket_framer *framer, const csocket_allocator_t *allocator) {
+	if(!framer) return;
+
+	// free
+	if(framer->buffer) {
+		_csFree(allocator, framer->buffer);
+		framer->buffer = NULL;
+	}
+
+	*framer = (const struct csocket_framer)CSOCKET_EMPTY;
+}
+
+/*
+	HISTOGRAMS
+*/
+int csocket_setHistograms(csocket_multiHandler_t *handler, int enable) {
+	if(!handler || !handler->src_socket) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	if(!enable) {
+		_csFree(&handler->allocator, handler->hist);
+		handler->hist = NULL;
+		return 0;
+	}
+	if(handler->hist) return 0;
+
+	handler->hist = _csCalloc(&handler->allocator, CSHIST_COUNT, sizeof(csocket_histogram_t));
+	if(!handler->hist) {
+		_csError(handler->src_socket, CSERR_ALLOC);
+		return -1;
+	}
+	return 0;
+}
+
+int csocket_getHistogram(const csocket_multiHandler_t *handler, int phase, csocket_histogram_t *snapshot) {
+	if(!handler || !handler->hist || !snapshot || phase<0 || phase>=CSHIST_COUNT) return -1;
+	*snapshot = handler->hist[phase];
+	return 0;
+}
+
+void csocket_resetHistograms(csocket_multiHandler_t *handler) {
+	if(!handler || !handler->hist) return;
+	memset(handler->hist, 0, CSHIST_COUNT*sizeof(csocket_histogram_t));
+}
+
+// precise time in ns, CSOCKET_CLOCK is too coarse for latencies
+static unsigned long long _histClock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+// start of a callback, records the time since the event in phase
+static unsigned long long _histBegin(csocket_multiHandler_t *handler, int phase, unsigned long long since) {
+	if(!handler->hist) return 0;
+	unsigned long long now = _histClock();
+	if(since && now>since)
+		csocket_histogram_record(&handler->hist[phase], now-since);
+	return now;
+}
+
+// end of a callback started with _histBegin
+static void _histEnd(csocket_multiHandler_t *handler, unsigned long long start) {
+	if(!handler->hist || !start) return;
+	csocket_histogram_record(&handler->hist[CSHIST_CALLBACK], _histClock()-start);
+}
+
+int csocket_getStats(const csocket_multiHandler_t *handler, const struct csocket_clients *client, csocket_stats_t *stats) {
+	if(!handler || !stats) return -1;
+
+	// one client
+	if(client) {
+		if(!client->stats) return -1;
+		*stats = *client->stats;
+		return 0;
+	}
+
+	// disconnected and connected clients
+	*stats = handler->stats;
+	if(handler->activities && handler->slab.slots) {
+		for(int i=0; i<handler->maxClients; ++i) {
+			if(handler->activities[i].client_socket.fd>0)
+				_statAdd(stats, &handler->slab.slots[i].stats);
+		}
+	}
+	return 0;
+}
+
+// count a recv call, returns res unchanged (errno is kept)
+static ssize_t _statRecv(csocket_stats_t *stats, ssize_t res, int flags) {
+	if(!stats) return res;
+	++stats->recv_calls;
+	if(res>0 && !(flags&MSG_PEEK))
+		stats->bytes_in += res;
+	else if(res<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+		++stats->eagain;
+	return res;
+}
+
+// count a send call, returns res unchanged (errno is kept)
+static ssize_t _statSend(csocket_stats_t *stats, ssize_t res) {
+	if(!stats) return res;
+	++stats->send_calls;
+	if(res>0)
+		stats->bytes_out += res;
+	else if(res<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+		++stats->eagain;
+	return res;
+}
+
+static void _statAdd(csocket_stats_t *dst, const csocket_stats_t *src) {
+	dst->bytes_in += src->bytes_in;
+	dst->bytes_out += src->bytes_out;
+	dst->recv_calls += src->recv_calls;
+	dst->send_calls += src->send_calls;
+	dst->eagain += src->eagain;
+	dst->ka_seen += src->ka_seen;
+	dst->ka_sent += src->ka_sent;
+	dst->ka_bytes += src->ka_bytes;
+	dst->messages += src->messages;
+	if(src->buffer_high>dst->buffer_high)
+		dst->buffer_high = src->buffer_high;
+}
+
+static void _statBuffer(csocket_stats_t *stats, size_t usage) {
+	if(stats && usage>stats->buffer_high)
+		stats->buffer_high = usage;
+}
+
+int csocket_setMetrics(csocket_multiHandler_t *handler, const csocket_addr_t *addr) {
+	if(!handler || !handler->src_socket || !handler->pfds) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	_freeMetrics(handler);
+	if(!addr) return 0;
+	if(!addr->addr || addr->addr_len<=0) {
+		_csError(handler->src_socket, CSERR_INVAL);
+		return -1;
+	}
+
+	csocket_metrics_t *metrics = _csCalloc(&handler->allocator, 1, sizeof(csocket_metrics_t));
+	if(!metrics) {
+		_csError(handler->src_socket, CSERR_ALLOC);
+		return -1;
+	}
+	metrics->conn = -1;
+
+	if((metrics->fd = socket(addr->addr->sa_family, SOCK_STREAM, 0))<0) {
+		_csFree(&handler->allocator, metrics);
+		_csError(handler->src_socket, CSERR_SOCKET);
+		return -1;
+	}
+	handler->metrics = metrics;
+
+	#ifdef _WIN32
+		char
+	#else 
+		int
+	#endif 
+		opt = 1;
+	setsockopt(metrics->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if(bind(metrics->fd, addr->addr, addr->addr_len)) {
+		_csError(handler->src_socket, CSERR_BIND);
+		_freeMetrics(handler);
+		return -1;
+	}
+	if(listen(metrics->fd, 8)) {
+		_csError(handler->src_socket, CSERR_LISTEN);
+		_freeMetrics(handler);
+		return -1;
+	}
+	_setNonBlock(metrics->fd, 1);
+
+	return 0;
+}
+
+ssize_t csocket_formatMetrics(const csocket_multiHandler_t *handler, char *buf, size_t len) {
+	if(!handler || !handler->activities || !buf) return -1;
+
+	int clients = 0;
+	for(int i=0; i<handler->maxClients; ++i) {
+		if(handler->activities[i].client_socket.fd>0 && !handler->activities[i].client_socket.connecting && !handler->activities[i].client_socket.handoff)
+			++clients;
+	}
+	csocket_stats_t stats;
+	csocket_getStats(handler, NULL, &stats);
+	const csocket_metrics_t *metrics = handler->metrics;
+	csocket_metrics_t none = CSOCKET_EMPTY;
+	if(!metrics)
+		metrics = &none;
+
+	size_t offset = 0;
+	int res = 0;
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_clients gauge\ncsocket_clients %d\n", clients);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_clients_max gauge\ncsocket_clients_max %d\n", handler->maxClients);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_accepted_total counter\ncsocket_accepted_total %llu\n", metrics->accepted);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_declined_total counter\ncsocket_declined_total %llu\n", metrics->declined);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_keepalive_timeouts_total counter\ncsocket_keepalive_timeouts_total %llu\n", metrics->ka_timeouts);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_received_bytes_total counter\ncsocket_received_bytes_total %llu\n", stats.bytes_in);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_sent_bytes_total counter\ncsocket_sent_bytes_total %llu\n", stats.bytes_out);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_recv_calls_total counter\ncsocket_recv_calls_total %llu\n", stats.recv_calls);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_send_calls_total counter\ncsocket_send_calls_total %llu\n", stats.send_calls);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_eagain_total counter\ncsocket_eagain_total %llu\n", stats.eagain);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_keepalives_total counter\ncsocket_keepalives_total %llu\n", stats.ka_seen);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_keepalive_bytes_total counter\ncsocket_keepalive_bytes_total %llu\n", stats.ka_bytes);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_messages_total counter\ncsocket_messages_total %llu\n", stats.messages);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_buffer_high_bytes gauge\ncsocket_buffer_high_bytes %llu\n", stats.buffer_high);
+	res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_loop_lag_seconds gauge\ncsocket_loop_lag_seconds %.9f\n", metrics->loop_gap/1e9);
+
+	// latency summaries, if histograms are enabled
+	if(handler->hist) {
+		static const char *phases[CSHIST_COUNT] = {"accept", "dispatch", "callback", "loop"};
+		static const double quantiles[] = {0.5, 0.99, 0.999};
+		res |= _metricsAppend(buf, len, &offset, "# TYPE csocket_latency_seconds summary\n");
+		for(int p=0; p<CSHIST_COUNT; ++p) {
+			const csocket_histogram_t *hist = &handler->hist[p];
+			for(int q=0; q<3; ++q)
+				res |= _metricsAppend(buf, len, &offset, "csocket_latency_seconds{phase=\"%s\",quantile=\"%g\"} %.9f\n", phases[p], quantiles[q], csocket_histogram_percentile(hist, quantiles[q])/1e9);
+			res |= _metricsAppend(buf, len, &offset, "csocket_latency_seconds_sum{phase=\"%s\"} %.9f\n", phases[p], hist->sum/1e9);
+			res |= _metricsAppend(buf, len, &offset, "csocket_latency_seconds_count{phase=\"%s\"} %llu\n", phases[p], hist->total);
+		}
+	}
+
+	return res?-1:(ssize_t)offset;
+}
+
+// serve one scrape at a time from the handler loop, further scrapes wait in the backlog
+static void _updateMetrics(csocket_multiHandler_t *handler, short listen_revents, short conn_revents) {
+	csocket_metrics_t *metrics = handler->metrics;
+
+	if(metrics->conn<0) {
+		if(!(listen_revents&POLLIN)) return;
+		if((metrics->conn = accept(metrics->fd, NULL, NULL))<0) {
+			metrics->conn = -1;
+			return;
+		}
+		_setNonBlock(metrics->conn, 1);
+		metrics->conn_since = *_csNow();
+		metrics->request_state = 0;
+		// the request often arrives with the connection
+		conn_revents = POLLIN;
+	}
+
+	// read the request up to the empty line, method and path are not looked at
+	if(conn_revents && metrics->request_state<2) {
+		char buf[512];
+		ssize_t res;
+		while(metrics->request_state<2 && (res = recv(metrics->conn, buf, sizeof buf, 0))>0) {
+			for(ssize_t i=0; i<res && metrics->request_state<2; ++i) {
+				if(buf[i]=='\n')
+					++metrics->request_state;
+				else if(buf[i]!='\r')
+					metrics->request_state = 0;
+			}
+		}
+		if(metrics->request_state<2 && (res==0 || (errno!=EAGAIN && errno!=EWOULDBLOCK))) {
+			_closeFd(metrics->conn);
+			metrics->conn = -1;
+			return;
+		}
+	}
+
+	if(metrics->request_state<2) {
+		if(_csNow()->tv_sec-metrics->conn_since.tv_sec>=CSMET_TIMEOUT) {
+			_closeFd(metrics->conn);
+			metrics->conn = -1;
+		}
+		return;
+	}
+
+	// page behind room for the header, no allocation
+	char buf[CSMET_BUFLEN];
+	const size_t head_room = 128;
+	ssize_t body = csocket_formatMetrics(handler, buf+head_room, sizeof buf-head_room);
+	char head[128];
+	int head_len;
+	if(body<0) {
+		body = 0;
+		head_len = snprintf(head, sizeof head, "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	}
+	else
+		head_len = snprintf(head, sizeof head, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zd\r\nConnection: close\r\n\r\n", body);
+	char *page = buf+head_room-head_len;
+	memcpy(page, head, head_len);
+
+	// fits the send buffer, a scraper that does not read gets a truncated page
+	size_t total = head_len+body;
+	for(size_t sent = 0; sent<total;) {
+		ssize_t r = send(metrics->conn, page+sent, total-sent, CS_MSG_NOSIGNAL);
+		if(r<=0) break;
+		sent += r;
+	}
+	_closeFd(metrics->conn);
+	metrics->conn = -1;
+	metrics->loop_gap = 0;
+}
+
+static int _metricsAppend(char *buf, size_t len, size_t *offset, const char *fmt, ...) {
+	if(*offset>=len) return -1;
+
+	va_list args;
+	va_start(args, fmt);
+	int res = vsnprintf(buf+*offset, len-*offset, fmt, args);
+	va_end(args);
+
+	if(res<0 || (size_t)res>=len-*offset) {
+		*offset = len;
+		return -1;
+	}
+	*offset += res;
+	return 0;
+}
+
+static void _freeMetrics(csocket_multiHandler_t *handler) {
+	if(!handler->metrics) return;
+
+	_closeFd(handler->metrics->conn);
+	_closeFd(handler->metrics->fd);
+	_csFree(&handler->allocator, handler->metrics);
+	handler->metrics = NULL;
+}
+
+/*
+	HANDOFF
+*/
+int csocket_handoffClient(csocket_multiHandler_t *handler, struct csocket_clients *client, int channel) {
+	if(!handler || !handler->src_socket || !client || client->fd<=0) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	#ifdef _WIN32
+		(void)channel;
+		errno = EOPNOTSUPP;
+		_csError(handler->src_socket, CSERR_DOMAIN);
+		return -1;
+	#else
+		// the stable client if the handler owns it, client may be a copy (onActivity)
+		int slot = -1;
+		for(int i=0; handler->activities && i<handler->maxClients; ++i) {
+			if(handler->activities[i].client_socket.fd==client->fd) {
+				slot = i;
+				break;
+			}
+		}
+		struct csocket_clients *owned = slot>=0?&handler->activities[slot].client_socket:client;
+		csocket_keepalive_t *ka = owned->ka;
+
+		if(owned->connecting || owned->handoff || !owned->addr || owned->addr_len<=0 || (size_t)owned->addr_len>sizeof(struct sockaddr_storage) || (ka && ka->msg_len>CSHOF_MSGLEN)) {
+			_csError(handler->src_socket, CSERR_INVAL);
+			return -1;
+		}
+		// data read ahead of the application would be lost
+		if((ka && ka->enabled && (ka->buffer_usage>0 || ka->frame_remaining>0)) || (slot>=0 && handler->slab.slots[slot].framer.usage>handler->slab.slots[slot].framer.start)) {
+			errno = EBUSY;
+			_csError(handler->src_socket, CSERR_INVAL);
+			return -1;
+		}
+
+		struct csocket_handoff head = CSOCKET_EMPTY;
+		head.version = CSHOF_VERSION;
+		head.domain = owned->domain;
+		head.addr_len = owned->addr_len;
+		head.connection_time = owned->connection_time;
+		head.ka_enabled = -1;
+		if(ka) {
+			head.ka_enabled = ka->enabled;
+			head.ka_timeout = ka->timeout;
+			head.ka_mode = ka->mode;
+			head.ka_msg_type = ka->msg_type;
+			head.ka_msg_len = ka->msg_len;
+			head.ka_buffer_len = ka->buffer_len;
+			head.ka_params_len = ka->params_len;
+		}
+		struct iovec iov[3] = {
+			{&head, sizeof(head)},
+			{owned->addr, owned->addr_len},
+			{ka?ka->msg:NULL, ka?ka->msg_len:0}
+		};
+
+		// one descriptor
+		union {
+			struct cmsghdr align;
+			char buf[CMSG_SPACE(sizeof(int))];
+		} control;
+		memset(&control, 0, sizeof(control));
+		struct msghdr msg = CSOCKET_EMPTY;
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 3;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &owned->fd, sizeof(int));
+
+		ssize_t res;
+		do {
+			res = sendmsg(channel, &msg, CS_MSG_NOSIGNAL);
+		} while(res<0 && errno==EINTR);
+		if(res<0) {
+			_csError(handler->src_socket, CSERR_SEND);
+			return -1;
+		}
+		CS_PROBE2(handoff, owned->fd, slot);
+
+		// released by the next csocket_multiServer call, clients without slot are closed by the caller
+		owned->handoff = 1;
+		client->handoff = 1;
+
+		return 0;
+	#endif
+}
+
+int csocket_adoptClient(csocket_multiHandler_t *handler, int channel) {
+	if(!handler || !handler->src_socket || !handler->activities) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	#ifdef _WIN32
+		(void)channel;
+		errno = EOPNOTSUPP;
+		_csError(handler->src_socket, CSERR_DOMAIN);
+		return -1;
+	#else
+		char buf[sizeof(struct csocket_handoff)+sizeof(struct sockaddr_storage)+CSHOF_MSGLEN];
+		struct iovec iov = {buf, sizeof(buf)};
+		union {
+			struct cmsghdr align;
+			char buf[CMSG_SPACE(sizeof(int))];
+		} control;
+		struct msghdr msg = CSOCKET_EMPTY;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		int flags = MSG_DONTWAIT;
+		#ifdef MSG_CMSG_CLOEXEC
+			flags |= MSG_CMSG_CLOEXEC;
+		#endif
+		ssize_t res;
+		do {
+			res = recvmsg(channel, &msg, flags);
+		} while(res<0 && errno==EINTR);
+		if(res<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) return 0;
+		// receiving the client is its accept, for the accept histogram
+		if(res>0 && handler->hist)
+			handler->hist_accept = _histClock();
+		if(res<=0) {
+			// sender is gone, stop polling the channel
+			if(res==0) {
+				errno = ENOTCONN;
+				if(channel==handler->handoff)
+					handler->handoff = 0;
+			}
+			_csError(handler->src_socket, CSERR_SOCKET);
+			return -1;
+		}
+
+		// received descriptors, all but the first are unexpected
+		int fd = -1;
+		for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if(cmsg->cmsg_level!=SOL_SOCKET || cmsg->cmsg_type!=SCM_RIGHTS) continue;
+			size_t count = (cmsg->cmsg_len-CMSG_LEN(0))/sizeof(int);
+			for(size_t i=0; i<count; ++i) {
+				int rfd;
+				memcpy(&rfd, CMSG_DATA(cmsg)+i*sizeof(int), sizeof(int));
+				if(fd<0)
+					fd = rfd;
+				else
+					_closeFd(rfd);
+			}
+		}
+
+		struct csocket_handoff head = CSOCKET_EMPTY;
+		if((size_t)res>=sizeof(head))
+			memcpy(&head, buf, sizeof(head));
+		if(fd<0 || (msg.msg_flags&(MSG_TRUNC|MSG_CTRUNC)) || (size_t)res<sizeof(head) || head.version!=CSHOF_VERSION ||
+		head.addr_len<=0 || (size_t)head.addr_len>sizeof(struct sockaddr_storage) || head.ka_msg_len>CSHOF_MSGLEN ||
+		(size_t)res!=sizeof(head)+head.addr_len+head.ka_msg_len) {
+			if(fd>=0)
+				_closeFd(fd);
+			errno = EPROTO;
+			_csError(handler->src_socket, CSERR_INVAL);
+			return -1;
+		}
+
+		// same state as an accepted client
+		struct csocket_clients client = CSOCKET_EMPTY;
+		struct sockaddr_storage declined_addr;
+		int slot = _slabAlloc(&handler->slab);
+		if(slot>=0) {
+			client.addr = (struct sockaddr*)&handler->slab.slots[slot].addr;
+			client.stats = &handler->slab.slots[slot].stats;
+		}
+		else
+			client.addr = (struct sockaddr*)&declined_addr;
+		memcpy(client.addr, buf+sizeof(head), head.addr_len);
+		client.addr_len = head.addr_len;
+		client.domain = head.domain;
+		client.fd = fd;
+		client.connection_time = head.connection_time;
+		client.timeout = handler->src_socket->timeout;
+		CS_PROBE2(adopt, fd, slot);
+		if(handler->metrics) {
+			if(slot>=0)
+				++handler->metrics->accepted;
+			else
+				++handler->metrics->declined;
+		}
+
+		// keepalive settings of the sender, socket options (kernel mode) came with the descriptor
+		if(slot>=0 && head.ka_enabled>=0) {
+			csocket_keepalive_t settings = CSOCKET_EMPTY;
+			settings.enabled = head.ka_enabled;
+			settings.timeout = head.ka_timeout;
+			settings.mode = head.ka_mode;
+			settings.msg_type = head.ka_msg_type;
+			settings.msg = buf+sizeof(head)+head.addr_len;
+			settings.msg_len = head.ka_msg_len;
+			settings.buffer_len = head.ka_buffer_len;
+			settings.params_len = head.ka_params_len;
+			settings.onActivity = handler->src_socket->ka?handler->src_socket->ka->onActivity:NULL;
+
+			client.ka = &handler->slab.slots[slot].ka;
+			if(_keepaliveCopy(client.ka, &settings, &handler->allocator)) {
+				_closeFd(fd);
+				_slabRelease(&handler->slab, slot);
+				_csError(handler->src_socket, CSERR_ALLOC);
+				return -1;
+			}
+			client.ka->stats = client.stats;
+			client.ka->fd = client.fd;
+			client.ka->address.domain = client.domain;
+			client.ka->address.addr = client.addr;
+			client.ka->address.addr_len = client.addr_len;
+		}
+
+		if(_admitClient(handler, slot, &client)) {
+			_csError(handler->src_socket, CSERR_POLL);
+			return -1;
+		}
+
+		return 1;
+	#endif
+}
+
+int csocket_setHandoff(csocket_multiHandler_t *handler, int channel) {
+	if(!handler || !handler->src_socket || !handler->pfds) return -1;
+	handler->src_socket->err = CSERR_NONE;
+
+	#ifdef _WIN32
+		(void)channel;
+		errno = EOPNOTSUPP;
+		_csError(handler->src_socket, CSERR_DOMAIN);
+		return -1;
+	#else
+		handler->handoff = channel>0?channel:0;
+		return 0;
+	#endif
+}
+
+/*
+	PREFORK
+*/
+int csocket_prefork_create(csocket_t *src_socket, int workers, int flags, int (*worker)(csocket_t *, int, void *), void *user, csocket_prefork_t *prefork) {
+	if(!src_socket || !prefork || src_socket->mode.sc!=1) return -1;
+	src_socket->err = CSERR_NONE;
+
+	#ifdef _WIN32
+		(void)workers;
+		(void)flags;
+		(void)worker;
+		(void)user;
+		errno = EOPNOTSUPP;
+		_csError(src_socket, CSERR_FORK);
+		return -1;
+	#else
+		// free prefork, just in case (the backlog is kept)
+		int backlog = prefork->backlog;
+		csocket_freePrefork(prefork);
+		prefork->backlog = backlog;
+
+		if(workers<1 || !worker || (flags&~CSPF_REUSEPORT) || ((flags&CSPF_REUSEPORT) && src_socket->domain==AF_UNIX)) {
+			_csError(src_socket, CSERR_INVAL);
+			return -1;
+		}
+		#ifdef SO_ACCEPTCONN
+			// per-worker sockets: connections queued at a listening parent would never be accepted
+			int listening = 0;
+			socklen_t len = sizeof(listening);
+			if((flags&CSPF_REUSEPORT) && !getsockopt(src_socket->mode.fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) && listening) {
+				_csError(src_socket, CSERR_INVAL);
+				return -1;
+			}
+		#endif
+
+		prefork->workers = _csCalloc(NULL, workers, sizeof(struct csocket_worker));
+		if(!prefork->workers) {
+			_csError(src_socket, CSERR_ALLOC);
+			return -1;
+		}
+		prefork->src_socket = src_socket;
+		prefork->flags = flags;
+		prefork->worker = worker;
+		prefork->user = user;
+		prefork->count = workers;
+
+		// workers that lose the race for a connection must not block in accept
+		if(!(flags&CSPF_REUSEPORT)) {
+			int flg = fcntl(src_socket->mode.fd, F_GETFL);
+			prefork->restore_block = flg!=-1 && !(flg&O_NONBLOCK);
+			_setNonBlock(src_socket->mode.fd, 1);
+		}
+
+		for(int i=0; i<workers; ++i) {
+			if(_forkWorker(prefork, i)) {
+				int err = errno;
+				csocket_freePrefork(prefork);
+				errno = err;
+				_csError(src_socket, CSERR_FORK);
+				return -1;
+			}
+		}
+
+		return 0;
+	#endif
+}
+
+int csocket_prefork_supervise(csocket_prefork_t *prefork) {
+	if(!prefork || !prefork->workers || !prefork->src_socket) return -1;
+	prefork->src_socket->err = CSERR_NONE;
+
+	#ifdef _WIN32
+		return -1;
+	#else
+		int running = 0, res = 0;
+		for(int i=0; i<prefork->count; ++i) {
+			struct csocket_worker *worker = &prefork->workers[i];
+			if(_reapWorker(worker, WNOHANG))
+				CS_PROBE2(worker__exit, i, worker->status);
+
+			// workers that crash right after the start are restarted once per interval
+			if(!worker->pid && worker->crashed && !prefork->stopping && _csNow()->tv_sec-worker->started.tv_sec>=CSPF_RESTART_INTERVAL) {
+				if(_forkWorker(prefork, i)) {
+					_csError(prefork->src_socket, CSERR_FORK);
+					res = -1;
+				}
+				else
+					++worker->restarts;
+			}
+			if(worker->pid)
+				++running;
+		}
+
+		return res?-1:running;
+	#endif
+}
+
+int csocket_prefork_stop(csocket_prefork_t *prefork, const struct timespec *timeout) {
+	if(!prefork || !prefork->workers) return -1;
+
+	#ifdef _WIN32
+		(void)timeout;
+		return -1;
+	#else
+		prefork->stopping = 1;
+		for(int i=0; i<prefork->count; ++i) {
+			if(prefork->workers[i].pid)
+				kill(prefork->workers[i].pid, SIGTERM);
+		}
+
+		// wait for all workers or the deadline
+		struct timespec deadline;
+		if(timeout)
+			csocket_deadline(&deadline, timeout);
+		int killed = 0;
+		for(;;) {
+			int running = 0;
+			for(int i=0; i<prefork->count; ++i) {
+				if(_reapWorker(&prefork->workers[i], WNOHANG))
+					CS_PROBE2(worker__exit, i, prefork->workers[i].status);
+				if(prefork->workers[i].pid)
+					++running;
+			}
+			if(!running) break;
+
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if(timeout && (now.tv_sec>deadline.tv_sec || (now.tv_sec==deadline.tv_sec && now.tv_nsec>=deadline.tv_nsec))) {
+				for(int i=0; i<prefork->count; ++i) {
+					if(!prefork->workers[i].pid) continue;
+					kill(prefork->workers[i].pid, SIGKILL);
+					_reapWorker(&prefork->workers[i], 0);
+					++killed;
+				}
+				break;
+			}
+			nanosleep(&(const struct timespec){0, 10000000L}, NULL);
+		}
+
+		return killed;
+	#endif
+}
+
+#ifndef _WIN32
+// fork worker index, the child runs the worker function and exits with its result
+static int _forkWorker(csocket_prefork_t *prefork, int index) {
+	struct csocket_worker *worker = &prefork->workers[index];
+
+	// buffered output would be written by both processes
+	fflush(NULL);
+	pid_t pid = fork();
+	if(pid<0) return -1;
+	if(pid>0) {
+		worker->pid = pid;
+		worker->started = *_csNow();
+		worker->crashed = 0;
+		CS_PROBE2(worker__start, index, pid);
+		return 0;
+	}
+
+	// worker, the clock of a multiServer iteration of the parent is not inherited
+	_cs_clock.depth = 0;
+	csocket_t *src_socket = prefork->src_socket;
+	if(prefork->flags&CSPF_REUSEPORT) {
+		// own listener on the bound address of the parent (port 0 resolved)
+		struct sockaddr_storage addr;
+		socklen_t addr_len = sizeof(addr);
+		int opt = 1;
+		int backlog = prefork->backlog>0?prefork->backlog:SOMAXCONN;
+		int fd = socket(src_socket->domain, src_socket->type, src_socket->protocol);
+		if(fd<0 || getsockname(src_socket->mode.fd, (struct sockaddr*)&addr, &addr_len) ||
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) ||
+		bind(fd, (struct sockaddr*)&addr, addr_len) || listen(fd, backlog))
+			_exit(EXIT_FAILURE);
+		_closeFd(src_socket->mode.fd);
+		src_socket->mode.fd = fd;
+	}
+
+	int res = prefork->worker(src_socket, index, prefork->user);
+	fflush(NULL);
+	_exit(res);
+}
+
+// collect the exit of a worker, returns 1 if it exited
+static int _reapWorker(struct csocket_worker *worker, int options) {
+	if(worker->pid<=0) return 0;
+
+	int status = 0;
+	pid_t res;
+	do {
+		res = waitpid(worker->pid, &status, options);
+	} while(res<0 && errno==EINTR);
+	if(res==0) return 0;
+
+	// res<0: reaped elsewhere (SIGCHLD ignored), counted as crash
+	worker->pid = 0;
+	worker->status = res<0?-1:status;
+	worker->crashed = res<0 || WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status)!=0);
+	return 1;
+}
+#endif
+
+#pragma endregion
+
+#pragma region CLIENT
+
+int csocket_connectClient(csocket_t *src_socket, struct timeval *timeout) {
+	if(!src_socket || src_socket->mode.sc!=2) return -1;
+	src_socket->err = CSERR_NONE;
+
+	struct csocket_client client = *((struct csocket_client*)&src_socket->mode);
+	
+	// disable block
+	#ifdef _WIN32
+		{
+			u_long iMode = 0;
+			ioctlsocket(client.client_fd, FIONBIO, &iMode);
+		}
+	#else
+		fcntl(client.client_fd, F_SETFL, O_NONBLOCK);
+	#endif
+	
+	// connect
+	if(connect(client.client_fd, client.addr, client.addr_len) == -1) {
+		if(errno != CS_EINPROGRESS) {
+			_csError(src_socket, CSERR_CONNECT);
+			return -1;
+		}
+	}
+	// verify connection
+	fd_set wr, rd;
+	FD_ZERO(&wr);
+	FD_ZERO(&rd);
+	FD_SET(client.client_fd, &wr);
+	FD_SET(client.client_fd, &rd);
+	int ret = select(client.client_fd+1, &rd, &wr, NULL, timeout);
+	if(ret == 0) {
+		_csError(src_socket, CSERR_TIMEOUT);
+		return -1;
+	}
+	if(ret < 0) {
+		_csError(src_socket, CSERR_CONNECT);
+		return -1;
+	}
+	#ifdef _WIN32
+		char
+	#else 
+		int
+	#endif 
+		err = 1;
+	socklen_t len = sizeof(int);
+	if((!FD_ISSET(client.client_fd, &rd)&&!FD_ISSET(client.client_fd, &wr)) || getsockopt(client.client_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+		_csError(src_socket, CSERR_CONNECT);
+		return -1;
+	}
+
+	#ifdef _WIN32
+		{
+			u_long iMode = 0;
+			ioctlsocket(client.client_fd, FIONBIO, &iMode);
+		}
+	#else
+		// enable block
+		int flg = fcntl(client.client_fd, F_GETFL);
+		if(flg!=-1)
+			fcntl(client.client_fd, F_SETFL, flg & ~O_NONBLOCK);
+	#endif
+
+	if(err != 0) {
+		errno = err;
+		_csError(src_socket, CSERR_CONNECT);
+		return -1;
+	}
+	return 0;
+}
+
+int csocket_connectMulti(const csocket_addr_t *addrs, int count, int type, int protocol, struct timeval *timeout, csocket_t *src_socket) {
+	if(!src_socket || !addrs || count<1) return -1;
+
+	csocket_free(src_socket);
+
+	struct pollfd *pfds = _csCalloc(NULL, count, sizeof(struct pollfd));
+	int *order = _csCalloc(NULL, count, sizeof(int));
+	if(!pfds || !order) {
+		_csFree(NULL, pfds);
+		_csFree(NULL, order);
+		_csError(src_socket, CSERR_ALLOC);
+		return -1;
+	}
+
+	// alternate address families, starting with the family of the first address
+	{
+		int n = 0, family = addrs[0].addr?addrs[0].addr->sa_family:AF_UNSPEC;
+		for(int k=0, a=0, b=0; n<count; ++k) {
+			int pick = -1;
+			if(k%2==0) {
+				while(a<count && (!addrs[a].addr || addrs[a].addr->sa_family!=family)) ++a;
+				if(a<count) pick = a++;
+			}
+			else {
+				while(b<count && (!addrs[b].addr || addrs[b].addr->sa_family==family)) ++b;
+				if(b<count) pick = b++;
+			}
+			if(pick>=0) order[n++] = pick;
+			else if(a>=count && b>=count) break;
+		}
+		count = n;
+	}
+
+	struct timespec now, deadline, next_start = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	deadline = now;
+	if(timeout) {
+		deadline.tv_sec += timeout->tv_sec+timeout->tv_usec/1000000;
+		deadline.tv_nsec += (timeout->tv_usec%1000000)*1000L;
+		if(deadline.tv_nsec>=1000000000L) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	int started = 0, active = 0, winner = -1, err = ECONNREFUSED;
+	while(winner<0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long long to_deadline = (long long)(deadline.tv_sec-now.tv_sec)*1000+(deadline.tv_nsec-now.tv_nsec)/1000000;
+		if(timeout && to_deadline<=0) {
+			err = ETIMEDOUT;
+			break;
+		}
+
+		// start the next attempt if none is running or the previous one is overdue
+		long long to_next = (long long)(next_start.tv_sec-now.tv_sec)*1000+(next_start.tv_nsec-now.tv_nsec)/1000000;
+		if(started<count && (active==0 || to_next<=0)) {
+			const csocket_addr_t *addr = &addrs[order[started]];
+			int fd = socket(addr->addr->sa_family, type, protocol);
+			pfds[started].fd = -1;
+			if(fd>=0) {
+				_setNonBlock(fd, 1);
+				if(connect(fd, addr->addr, addr->addr_len)==0) {
+					pfds[started].fd = fd;
+					winner = started;
+				}
+				else if(errno==CS_EINPROGRESS || errno==EWOULDBLOCK) {
+					pfds[started].fd = fd;
+					pfds[started].events = POLLOUT;
+					++active;
+				}
+				else {
+					err = errno;
+					_closeFd(fd);
+				}
+			}
+			++started;
+			next_start = now;
+			next_start.tv_nsec += CSOCKET_CONNECT_DELAY*1000000L;
+			if(next_start.tv_nsec>=1000000000L) {
+				next_start.tv_sec += 1;
+				next_start.tv_nsec -= 1000000000L;
+			}
+			continue;
+		}
+		if(active==0) break;
+
+		int wait_ms = -1;
+		if(started<count) wait_ms = to_next>0?(int)to_next:0;
+		if(timeout && (wait_ms<0 || to_deadline<wait_ms)) wait_ms = (int)to_deadline;
+
+		#ifdef _WIN32
+			int res = WSAPoll(pfds, started, wait_ms);
+		#else
+			int res = poll(pfds, started, wait_ms);
+		#endif
+		if(res<0 && errno!=EINTR) {
+			err = errno;
+			break;
+		}
+
+		for(int i=0; res>0 && i<started; ++i) {
+			if(pfds[i].fd<0 || !pfds[i].revents) continue;
+			#ifdef _WIN32
+				char
+			#else 
+				int
+			#endif 
+				soerr = 0;
+			socklen_t len = sizeof(soerr);
+			if(getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &soerr, &len)==0 && soerr==0) {
+				winner = i;
+				break;
+			}
+			// failed, the next attempt starts right away
+			err = soerr?soerr:ECONNREFUSED;
+			_closeFd(pfds[i].fd);
+			pfds[i].fd = -1;
+			--active;
+			next_start = now;
+		}
+	}
+
+	// close the losers
+	for(int i=0; i<started; ++i) {
+		if(i!=winner && pfds[i].fd>=0)
+			_closeFd(pfds[i].fd);
+	}
+
+	int rv = -1;
+	if(winner>=0) {
+		const csocket_addr_t *addr = &addrs[order[winner]];
+		src_socket->domain = addr->addr->sa_family;
+		src_socket->type = type;
+		src_socket->protocol = protocol;
+		src_socket->mode.fd = pfds[winner].fd;
+		src_socket->mode.sc = 2;
+		src_socket->mode.addr = _csMalloc(NULL, addr->addr_len);
+		if(src_socket->mode.addr) {
+			memcpy(src_socket->mode.addr, addr->addr, addr->addr_len);
+			src_socket->mode.addr_len = addr->addr_len;
+			_setNonBlock(src_socket->mode.fd, 0);
+			rv = 0;
+		}
+		else {
+			_closeFd(pfds[winner].fd);
+			src_socket->mode.fd = 0;
+			_csError(src_socket, CSERR_ALLOC);
+		}
+	}
+	else {
+		errno = err;
+		_csError(src_socket, err==ETIMEDOUT?CSERR_TIMEOUT:CSERR_CONNECT);
+	}
+
+	_csFree(NULL, pfds);
+	_csFree(NULL, order);
+	return rv;
+}
+
+static void _setNonBlock(int fd, int enable) {
+	#ifdef _WIN32
+		u_long iMode = enable?1:0;
+		ioctlsocket(fd, FIONBIO, &iMode);
+	#else
+		int flg = fcntl(fd, F_GETFL);
+		if(flg!=-1)
+			fcntl(fd, F_SETFL, enable?(flg|O_NONBLOCK):(flg&~O_NONBLOCK));
+	#endif
+}
+
+ssize_t csocket_connectSend(csocket_t *src_socket, const void *buf, size_t len, int flags, struct timeval *timeout) {
+	if(!src_socket || src_socket->mode.sc!=2) return -1;
+	src_socket->err = CSERR_NONE;
+
+	#if defined(TCP_FASTOPEN_CONNECT) || defined(MSG_FASTOPEN)
+		if(src_socket->type == SOCK_STREAM) {
+			int fastopen = 0;
+			#ifdef TCP_FASTOPEN_CONNECT
+				// connect returns right away, the first send carries the data in the SYN
+				int opt = 1;
+				fastopen = setsockopt(src_socket->mode.fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &opt, sizeof(opt))==0;
+			#endif
+			#ifdef MSG_FASTOPEN
+				// option not available, connect and send in one call, no timeout
+				if(!fastopen && !(src_socket->ka && src_socket->ka->enabled && src_socket->ka->mode==CSKA_MODE_FRAMED)) {
+					ssize_t res = _statSend(&src_socket->stats, sendto(src_socket->mode.fd, buf, len, flags|MSG_FASTOPEN, src_socket->mode.addr, src_socket->mode.addr_len));
+					// without Fast Open support in the kernel, connect and send separately
+					if(res>=0 || errno!=EOPNOTSUPP) {
+						if(res<0) _csError(src_socket, CSERR_CONNECT);
+						return res;
+					}
+				}
+			#endif
+			(void)fastopen;
+		}
+	#endif
+
+	if(csocket_connectClient(src_socket, timeout)) return -1;
+
+	ssize_t res = csocket_send(src_socket, (void*)buf, len, flags);
+	if(res<0) _csError(src_socket, CSERR_SEND);
+	return res;
+}
+
+/*
+	POOL
+*/
+
+int csocket_pool_create(int capacity, int max_per_dest, int idle_timeout, int type, int protocol, csocket_pool_t *pool) {
+	if(!pool || capacity<1) return -1;
+
+	csocket_freePool(pool);
+
+	pool->entries = _csCalloc(NULL, capacity, sizeof(struct csocket_pool_entry));
+	if(!pool->entries) return -1;
+	pool->capacity = capacity;
+	pool->max_per_dest = max_per_dest>0?max_per_dest:0;
+	pool->idle_timeout = idle_timeout>0?idle_timeout:CSKA_TIMEOUT;
+	pool->type = type;
+	pool->protocol = protocol;
+
+	return 0;
+}
+
+csocket_t * csocket_pool_get(csocket_pool_t *pool, const csocket_addr_t *dst, struct timeval *timeout) {
+	if(!pool || !pool->entries || !dst || !dst->addr) return NULL;
+	if(dst->addr_len<=0 || (size_t)dst->addr_len>sizeof(struct sockaddr_storage)) return NULL;
+
+	const struct timespec *now = _csNow();
+	int count = 0, empty = -1, oldest = -1;
+	for(int i=0; i<pool->capacity; ++i) {
+		struct csocket_pool_entry *entry = &pool->entries[i];
+		if(entry->socket.mode.fd<=0) {
+			if(empty<0) empty = i;
+			continue;
+		}
+
+		int match = entry->addr_len==dst->addr_len && memcmp(&entry->addr, dst->addr, dst->addr_len)==0;
+		if(entry->busy) {
+			count += match;
+			continue;
+		}
+
+		// expired or closed by the peer
+		if(now->tv_sec-entry->idle_since.tv_sec>=pool->idle_timeout || (match && !_poolAlive(entry->socket.mode.fd))) {
+			_poolClose(entry);
+			if(empty<0) empty = i;
+			continue;
+		}
+
+		// reuse, no handshake
+		if(match) {
+			entry->busy = 1;
+			return &entry->socket;
+		}
+
+		if(oldest<0 || entry->idle_since.tv_sec<pool->entries[oldest].idle_since.tv_sec)
+			oldest = i;
+	}
+
+	if(pool->max_per_dest && count>=pool->max_per_dest) {
+		errno = EBUSY;
+		return NULL;
+	}
+	// full, evict the longest idle connection to another destination
+	if(empty<0) {
+		if(oldest<0) {
+			errno = EBUSY;
+			return NULL;
+		}
+		_poolClose(&pool->entries[oldest]);
+		empty = oldest;
+	}
+
+	// new connection
+	struct csocket_pool_entry *entry = &pool->entries[empty];
+	memcpy(&entry->addr, dst->addr, dst->addr_len);
+	entry->addr_len = dst->addr_len;
+
+	csocket_t *src_socket = &entry->socket;
+	src_socket->domain = entry->addr.ss_family;
+	src_socket->type = pool->type;
+	src_socket->protocol = pool->protocol;
+	if((src_socket->mode.fd = socket(src_socket->domain, src_socket->type, src_socket->protocol)) < 0) {
+		src_socket->mode.fd = 0;
+		return NULL;
+	}
+	src_socket->mode.addr = (struct sockaddr*)&entry->addr;
+	src_socket->mode.addr_len = entry->addr_len;
+	src_socket->mode.sc = 2;
+
+	if(csocket_connectClient(src_socket, timeout)) {
+		_poolClose(entry);
+		return NULL;
+	}
+
+	entry->busy = 1;
+	return src_socket;
+}
+
+int csocket_pool_put(csocket_pool_t *pool, csocket_t *src_socket, int reuse) {
+	if(!pool || !pool->entries || !src_socket) return -1;
+
+	// socket is the first member of its entry
+	size_t offset = (size_t)((char*)src_socket-(char*)pool->entries);
+	if((char*)src_socket<(char*)pool->entries || offset%sizeof(struct csocket_pool_entry) || offset/sizeof(struct csocket_pool_entry)>=(size_t)pool->capacity)
+		return -1;
+	struct csocket_pool_entry *entry = &pool->entries[offset/sizeof(struct csocket_pool_entry)];
+	if(!entry->busy) return -1;
+
+	entry->busy = 0;
+	if(!reuse || !_poolAlive(entry->socket.mode.fd)) {
+		_poolClose(entry);
+		return 0;
+	}
+	entry->idle_since = *_csNow();
+
+	return 0;
+}
+
+int csocket_pool_prune(csocket_pool_t *pool) {
+	if(!pool || !pool->entries) return -1;
+
+	const struct timespec *now = _csNow();
+	int closed = 0;
+	for(int i=0; i<pool->capacity; ++i) {
+		struct csocket_pool_entry *entry = &pool->entries[i];
+		if(entry->socket.mode.fd<=0 || entry->busy) continue;
+		if(now->tv_sec-entry->idle_since.tv_sec>=pool->idle_timeout || !_poolAlive(entry->socket.mode.fd)) {
+			_poolClose(entry);
+			++closed;
+		}
+	}
+
+	return closed;
+}
+
+// idle connection is reusable: no EOF, error or unread data
+static int _poolAlive(int fd) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	#ifdef _WIN32
+		int res = WSAPoll(&pfd, 1, 0);
+	#else
+		int res = poll(&pfd, 1, 0);
+	#endif
+	if(res==0) return 1;
+	return 0;
+}
+
+static void _poolClose(struct csocket_pool_entry *entry) {
+	_closeFd(entry->socket.mode.fd);
+	*entry = (const struct csocket_pool_entry)CSOCKET_EMPTY;
+}
+
+#pragma endregion
+
+#pragma region UTIL
+
+static const char *_csocket_errstr[CSERR_COUNT] = {
+	[CSERR_NONE] = "no error",
+	[CSERR_ADDR] = "missing address",
+	[CSERR_DOMAIN] = "invalid domain",
+	[CSERR_TYPE] = "invalid type",
+	[CSERR_SOCKET] = "create socket",
+	[CSERR_SOCKOPT] = "socket option",
+	[CSERR_ALLOC] = "out of memory",
+	[CSERR_BIND] = "bind",
+	[CSERR_LISTEN] = "listen",
+	[CSERR_ACCEPT] = "accept",
+	[CSERR_CONNECT] = "connect",
+	[CSERR_TIMEOUT] = "timeout",
+	[CSERR_SEND] = "send",
+	[CSERR_POLL] = "poll",
+	[CSERR_INVAL] = "invalid argument",
+	[CSERR_NOCLIENT] = "no such client",
+	[CSERR_KADISABLED] = "keepalive not enabled",
+	[CSERR_KANOTDUE] = "keepalive not due",
+	[CSERR_FORK] = "fork",
+};
+
+const char * csocket_strerror(int err) {
+	if(err<0 || err>=CSERR_COUNT || !_csocket_errstr[err]) return "unknown error";
+	return _csocket_errstr[err];
+}
+
+static void _csError(csocket_t *src_socket, int err) {
+	src_socket->err_errno = errno;
+	src_socket->err = err;
+}
+
+void csocket_now(struct timespec *now) {
+	if(now) *now = *_csNow();
+}
+
+static const struct timespec * _csNow(void) {
+	if(!_cs_clock.depth)
+		clock_gettime(CSOCKET_CLOCK, &_cs_clock.now);
+	return &_cs_clock.now;
+}
+
+static time_t _csTime(void) {
+	if(!_cs_clock.depth)
+		_cs_clock.wall = time(NULL);
+	return _cs_clock.wall;
+}
+
+static void _csClockBegin(void) {
+	if(_cs_clock.depth++) return;
+	clock_gettime(CSOCKET_CLOCK, &_cs_clock.now);
+	_cs_clock.wall = time(NULL);
+}
+
+static void _csClockEnd(void) {
+	if(_cs_clock.depth>0) --_cs_clock.depth;
+}
+
+static void _kaSignal(csocket_keepalive_t *ka) {
+	ka->last_sig = _csTime();
+	ka->last_seen = *_csNow();
+}
+
+// last keepalive less than seconds ago, never signalled ({0}) counts as expired independent of the uptime
+static int _kaWithin(const csocket_keepalive_t *ka, time_t seconds) {
+	if(ka->last_seen.tv_sec==0 && ka->last_seen.tv_nsec==0) return 0;
+	return _csNow()->tv_sec-ka->last_seen.tv_sec<seconds;
+}
+
+const char * csocket_ntop(int domain, const void *addr, char *dst, socklen_t len) {
+	#ifndef _WIN32
+		if(domain==AF_UNIX)
+			return _ntopUnix(addr, sizeof(((const struct sockaddr_un*)addr)->sun_path), dst, len);
+	#endif
+	return inet_ntop(domain, domain==AF_INET?(void*)&(((struct sockaddr_in*)addr)->sin_addr):(void*)&(((struct sockaddr_in6*)addr)->sin6_addr), dst, len);
+}
+
+const char * csocket_ntopA(const csocket_addr_t *addr, char *dst, socklen_t len) {
+	if(!addr) return NULL;
+	#ifndef _WIN32
+		if(addr->domain==AF_UNIX) {
+			socklen_t offset = offsetof(struct sockaddr_un, sun_path);
+			return _ntopUnix(addr->addr, addr->addr_len>offset?addr->addr_len-offset:0, dst, len);
+		}
+	#endif
+	return csocket_ntop(addr->domain, addr->addr, dst, len);
+}
+
+#ifndef _WIN32
+// path of a Unix address, abstract names (leading 0 byte) are shown with a leading '@', unnamed peers are empty
+static const char * _ntopUnix(const void *addr, size_t size, char *dst, socklen_t len) {
+	if(!addr || !dst || len<=0) return NULL;
+
+	const char *path = ((const struct sockaddr_un*)addr)->sun_path;
+	int abstract = size>1 && path[0]==0;
+	size_t path_len = size>0?strnlen(path+abstract, size-abstract):0;
+	if(path_len+abstract>=(size_t)len) {
+		errno = ENOSPC;
+		return NULL;
+	}
+	if(abstract)
+		dst[0] = '@';
+	memcpy(dst+abstract, path+abstract, path_len);
+	dst[path_len+abstract] = 0;
+	return dst;
+}
+#endif
+
+// bucket of a value, see CSHIST_SUB
+static int _histBucket(unsigned long long value) {
+	if(value<2*CSHIST_SUB) return (int)value;
+	int shift = 63-__builtin_clzll(value)-CSHIST_SUB_BITS;
+	int index = 2*CSHIST_SUB+(shift-1)*CSHIST_SUB+(int)(value>>shift)-CSHIST_SUB;
+	return index<CSHIST_BUCKETS?index:CSHIST_BUCKETS-1;
+}
+
+void csocket_histogram_record(csocket_histogram_t *hist, unsigned long long value) {
+	if(!hist) return;
+	++hist->counts[_histBucket(value)];
+	++hist->total;
+	hist->sum += value;
+	if(value>hist->max)
+		hist->max = value;
+}
+
+unsigned long long csocket_histogram_percentile(const csocket_histogram_t *hist, double p) {
+	if(!hist || !hist->total) return 0;
+	unsigned long long rank = (unsigned long long)(p*hist->total+0.5), seen = 0;
+	if(rank<1) rank = 1;
+
+	for(int i=0; i<CSHIST_BUCKETS; ++i) {
+		seen += hist->counts[i];
+		if(seen<rank) continue;
+		if(i<2*CSHIST_SUB) return i;
+
+		// upper end of the bucket, never above the largest value
+		int shift = (i-2*CSHIST_SUB)/CSHIST_SUB+1;
+		unsigned long long upper = ((unsigned long long)((i-2*CSHIST_SUB)%CSHIST_SUB+CSHIST_SUB+1)<<shift)-1;
+		return upper<hist->max?upper:hist->max;
+	}
+	return hist->max;
+}
+
+void csocket_histogram_merge(csocket_histogram_t *dst, const csocket_histogram_t *src) {
+	if(!dst || !src) return;
+	for(int i=0; i<CSHIST_BUCKETS; ++i)
+		dst->counts[i] += src->counts[i];
+	dst->total += src->total;
+	dst->sum += src->sum;
+	if(src->max>dst->max)
+		dst->max = src->max;
+}
+
+#pragma endregion
+
+#pragma region FREE
+
+// free
+void csocket_free(csocket_t *src_socket) {
+	if(!src_socket) return;
+	src_socket->err = CSERR_NONE;
+	
+	// free
+	if(src_socket->mode.sc>0&&src_socket->mode.addr) {
+		_csFree(NULL, src_socket->mode.addr);
+		src_socket->mode.addr = NULL;
+	}
+
+	// close fd
+	if(src_socket->mode.fd>=0)
+		shutdown(src_socket->mode.fd, SHUT_RDWR);
+	if(src_socket->mode.sc==1&&((struct csocket_server*)&src_socket->mode)->client_fd>=0)
+		shutdown(((struct csocket_server*)&src_socket->mode)->client_fd, SHUT_RDWR);
+
+	csocket_freeKeepalive(src_socket->ka);
+	
+	// reset
+	*src_socket = (const csocket_t)CSOCKET_EMPTY;
+}
+
+void csocket_freePool(csocket_pool_t *pool) {
+	if(!pool) return;
+
+	if(pool->entries) {
+		for(int i=0; i<pool->capacity; ++i)
+			_poolClose(&pool->entries[i]);
+		_csFree(NULL, pool->entries);
+	}
+
+	*pool = (const csocket_pool_t)CSOCKET_EMPTY;
+}
+
+void csocket_freePrefork(csocket_prefork_t *prefork) {
+	if(!prefork) return;
+
+	// workers still running are killed without waiting
+	if(prefork->workers) {
+		csocket_prefork_stop(prefork, &(const struct timespec){0, 0});
+		_csFree(NULL, prefork->workers);
+	}
+	if(prefork->restore_block && prefork->src_socket)
+		_setNonBlock(prefork->src_socket->mode.fd, 0);
+
+	*prefork = (const csocket_prefork_t)CSOCKET_EMPTY;
+}
+
+void csocket_freeActivity(csocket_activity_t *activity) {
+	if(!activity) return;
+
+	// free
+	if(activity->client_socket.addr) {
+		_csFree(NULL, activity->client_socket.addr);
+		activity->client_socket.addr = NULL;
+	}
+
+	// close fd
+	if(activity->client_socket.fd>=0)
+		shutdown(activity->client_socket.fd, SHUT_RDWR);
+	// reset
+	*activity = (const csocket_activity_t)CSOCKET_EMPTY;
+}
+
+void csocket_freeMultiHandler(csocket_multiHandler_t *handler) {
+	if(!handler) return;
+
+	// free
+	if(handler->activities) {
+		_csFree(&handler->allocator, handler->activities);
+		handler->activities = NULL;
+	}
+	if(handler->pfds) {
+		_csFree(&handler->allocator, handler->pfds);
+		handler->pfds = NULL;
+	}
+	_slabFree(&handler->slab, &handler->allocator);
+	_csFree(&handler->allocator, handler->hist);
+	_freeMetrics(handler);
+
+	// reset
 	*handler = (const csocket_multiHandler_t)CSOCKET_EMPTY;
 }
 
@@ -1581,7 +3968,7 @@ void csocket_freeClients(struct csocket_clients *client) {
 
 	// free
 	if(client->addr) {
-		free(client->addr);
+		_csFree(NULL, client->addr);
 		client->addr = NULL;
 	}
 
@@ -1592,21 +3979,25 @@ void csocket_freeClients(struct csocket_clients *client) {
 }
 
 void csocket_freeKeepalive(csocket_keepalive_t *ka) {
+	_freeKeepalive(ka, NULL);
+}
+
+static void _freeKeepalive(csocket_keepalive_t *ka, const csocket_allocator_t *allocator) {
 	if(!ka) return;
 
 	// free
 	if(ka->buffer) {
-		free(ka->buffer);
+		_csFree(allocator, ka->buffer);
 		ka->buffer = NULL;
 	}
 	// free
 	if(ka->msg) {
-		free(ka->msg);
+		_csFree(allocator, ka->msg);
 		ka->msg = NULL;
 	}
 	// free
 	if(ka->params) {
-		free(ka->params);
+		_csFree(allocator, ka->params);
 		ka->params = NULL;
 	}
 
@@ -1620,12 +4011,21 @@ void csocket_freeKeepalive(csocket_keepalive_t *ka) {
 // close connection
 void csocket_close(csocket_t *src_socket) {
 	if(!src_socket) return;
-	strcpy(src_socket->last_err, "");
+	src_socket->err = CSERR_NONE;
 
 	// free (close remaining fds)
 	csocket_free(src_socket);
 }
 
+static void _closeFd(int fd) {
+	if(fd<=0) return;
+	#ifdef _WIN32
+		closesocket(fd);
+	#else
+		close(fd);
+	#endif
+}
+
 // non callable funtions
 static void __attribute__((constructor)) csocket_constructor() {
 	#ifdef _WIN32
@@ -31,6 +31,7 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <io.h>
 #include <time.h>
 
@@ -52,6 +53,15 @@ typedef struct in_addr in_addr_t;
 // errno
 #define CS_EINPROGRESS WSAEINPROGRESS
 
+// thread-local storage
+#define CS_THREAD_LOCAL __declspec(thread)
+
+// exceptional conditions for poll, not supported by WSAPoll
+#define CS_POLLEX 0
+
+// no SIGPIPE on Windows
+#define CS_MSG_NOSIGNAL 0
+
 #else 
 
 // MESSAGES
@@ -65,20 +75,86 @@ typedef struct in_addr in_addr_t;
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
 
 // errno
 #define CS_EINPROGRESS EINPROGRESS
 
+// thread-local storage
+#define CS_THREAD_LOCAL __thread
+
+// exceptional conditions for poll
+#define CS_POLLEX POLLPRI
+
+// send without SIGPIPE, where supported
+#ifdef MSG_NOSIGNAL
+#define CS_MSG_NOSIGNAL MSG_NOSIGNAL
+#else
+#define CS_MSG_NOSIGNAL 0
+#endif
+
 #endif
 
 extern const struct in_addr inaddr_any;
+// default read timeout, used by sockets without their own (see csocket_setTimeout)
 extern struct timespec csocket_timeout; 
 
+// clock for timeouts and event timestamps, coarse is enough and cheaper
+#ifdef CLOCK_MONOTONIC_COARSE
+#define CSOCKET_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define CSOCKET_CLOCK CLOCK_MONOTONIC
+#endif
+
+// static tracepoints (USDT, provider csocket), build with -DCSOCKET_USDT and sys/sdt.h, a nop unless attached
+#if defined(CSOCKET_USDT) && !defined(_WIN32)
+#include <sys/sdt.h>
+#define CS_PROBE2(name, a, b) DTRACE_PROBE2(csocket, name, a, b)
+#define CS_PROBE3(name, a, b, c) DTRACE_PROBE3(csocket, name, a, b, c)
+#else
+#define CS_PROBE2(name, a, b) do { (void)(a); (void)(b); } while(0)
+#define CS_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while(0)
+#endif
+
 
 #define CSOCKET_EMPTY {0}
 
+// largest csocket_ntop result, Unix socket paths included
+#define CSOCKET_ADDRSTRLEN 110
+
+// error codes, see csocket_strerror
+#define CSERR_NONE 0
+#define CSERR_ADDR 1
+#define CSERR_DOMAIN 2
+#define CSERR_TYPE 3
+#define CSERR_SOCKET 4
+#define CSERR_SOCKOPT 5
+#define CSERR_ALLOC 6
+#define CSERR_BIND 7
+#define CSERR_LISTEN 8
+#define CSERR_ACCEPT 9
+#define CSERR_CONNECT 10
+#define CSERR_TIMEOUT 11
+#define CSERR_SEND 12
+#define CSERR_POLL 13
+#define CSERR_INVAL 14
+#define CSERR_NOCLIENT 15
+#define CSERR_KADISABLED 16
+#define CSERR_KANOTDUE 17
+#define CSERR_FORK 18
+#define CSERR_COUNT 19
+
 struct csocket_mode {
 	// common
 	int fd;
@@ -117,11 +193,43 @@ struct csocket_client {
 	int sc;
 };
 
+/*
+	STATS
+*/
+// plain counters, updated by the thread that owns the socket (no atomics)
+typedef struct csocket_stats {
+	// payload and keepalive bytes through recv/send
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+	// recv (peeks included) and send calls, calls failed with EAGAIN/EWOULDBLOCK
+	unsigned long long recv_calls;
+	unsigned long long send_calls;
+	unsigned long long eagain;
+	// keepalives received and sent, keepalive bytes removed from the stream
+	unsigned long long ka_seen;
+	unsigned long long ka_sent;
+	unsigned long long ka_bytes;
+	// messages handed to onMessage
+	unsigned long long messages;
+	// largest receive buffer usage (keepalive or framing buffer)
+	unsigned long long buffer_high;
+} csocket_stats_t;
+
 // default timeout of 2 min (timeout in seconds)
 #define CSKA_TIMEOUT 120
 #define CSKA_DEFAULTMSG "CSKA%UNIX%-%HOST%-%USER%\0"
 #define CSKA_DEFAULTMSGLEN 25
 
+// keepalive modes
+#define CSKA_MODE_INBAND 0
+#define CSKA_MODE_FRAMED 1
+#define CSKA_MODE_KERNEL 2
+
+// framed mode: 1 byte type, 4 byte payload length (network byte order)
+#define CSKA_FRAME_HDRLEN 5
+#define CSKA_FRAME_DATA 1
+#define CSKA_FRAME_KEEPALIVE 2
+
 typedef struct csocket_keepalive {
 	int enabled;
 	// keepalive timeout in seconds
@@ -149,28 +257,29 @@ typedef struct csocket_keepalive {
 	socklen_t params_len;
 	socklen_t params_usage;
 	time_t last_sig;
+	// last keepalive (CSOCKET_CLOCK), used for timeouts
+	struct timespec last_seen;
 	// handler function
 	void (*onActivity)(struct csocket_keepalive *);
 
 	int fd;
 	csocket_addr_t address;
 	time_t connection_time;
-} csocket_keepalive_t;
-
-typedef struct csocket {
-	// sys/socket fields
-	int domain;
-	int type;
-	int protocol;
-	// server/client
-	struct csocket_mode mode;
 
-	// keepalive (global settings)
-	struct csocket_keepalive *ka;
-
-	// error
-	char last_err[32];
-} csocket_t;
+	/**
+	 * keepalive modes:
+	 * CSKA_MODE_INBAND - message is searched in the byte stream (default)
+	 * CSKA_MODE_FRAMED - every send is framed, keepalives are told apart by the frame header (stream sockets only)
+	 * CSKA_MODE_KERNEL - TCP keepalive probes by the kernel, no user-space buffer (stream sockets only)
+	**/
+	int mode;
+	// framed mode: unread payload of the current data frame
+	size_t frame_remaining;
+	// kernel mode: error reported by the socket, peer is gone if set
+	int error;
+	// counters of the owning socket or client, NULL if not counted
+	csocket_stats_t *stats;
+} csocket_keepalive_t;
 
 /*
 	multiHandler
@@ -186,6 +295,16 @@ struct csocket_clients {
 	struct csocket_keepalive *ka;
 	// manual shutdown
 	char shutdown;
+	// user data, kept until disconnect
+	void *user;
+	// read timeout, zero uses csocket_timeout
+	struct timespec timeout;
+	// outbound connect in progress (csocket_connectAsync)
+	char connecting;
+	// counters, kept in the slot of the client (NULL if not counted)
+	csocket_stats_t *stats;
+	// sent to another process (csocket_handoffClient), released without shutdown
+	char handoff;
 };
 
 /*
@@ -198,6 +317,9 @@ struct csocket_clients {
 #define CSACT_TYPE_WRITE 8
 #define CSACT_TYPE_EXT 16
 #define CSACT_TYPE_DECLINED 32
+// outbound connect (csocket_connectAsync) completed / failed, errno holds the reason on failure
+#define CSACT_TYPE_CONNOUT 64
+#define CSACT_TYPE_CONNFAIL 128
 
 
 typedef struct csocket_activity {
@@ -208,19 +330,279 @@ typedef struct csocket_activity {
 	// timestamps
 	time_t time;
 	time_t update_time;
+	// event time (CSOCKET_CLOCK), sub-second
+	struct timespec ts;
 } csocket_activity_t;
 
+/*
+	SOCKET
+*/
+typedef struct csocket {
+	// sys/socket fields
+	int domain;
+	int type;
+	int protocol;
+	// server/client
+	struct csocket_mode mode;
+
+	// keepalive (global settings)
+	struct csocket_keepalive *ka;
+
+	// activity reused by the keepalive read path, set up on first use
+	csocket_activity_t act;
+	int act_init;
+
+	// read timeout, zero uses csocket_timeout
+	struct timespec timeout;
+
+	// last error (CSERR_*) and errno at that time
+	int err;
+	int err_errno;
+
+	// counters, see csocket_stats_t
+	csocket_stats_t stats;
+} csocket_t;
+
+
+/*
+	ALLOCATOR
+*/
+typedef struct csocket_allocator {
+	// required, same contract as malloc/realloc/free
+	void *(*alloc)(size_t size, void *ctx);
+	void *(*resize)(void *ptr, size_t size, void *ctx);
+	void (*release)(void *ptr, void *ctx);
+	// optional, emulated through alloc if NULL
+	void *(*zalloc)(size_t nmemb, size_t size, void *ctx);
+	// user context passed to every call
+	void *ctx;
+} csocket_allocator_t;
+
+/*
+	FRAMING
+*/
+#define CSFRM_TYPE_NONE 0
+// length prefix of param (1, 2 or 4) bytes in network byte order
+#define CSFRM_TYPE_LENGTH 1
+// messages of exactly param bytes
+#define CSFRM_TYPE_FIXED 2
+// messages terminated by the byte param (not part of the message)
+#define CSFRM_TYPE_DELIM 3
+
+struct csocket_framer {
+	int type;
+	size_t param;
+	// largest message payload
+	size_t max_len;
+	// receive buffer, partial messages stay in place across reads
+	char *buffer;
+	size_t buffer_len;
+	// unconsumed data is buffer[start, usage)
+	size_t start;
+	size_t usage;
+	// delimiter search resumes at start+scanned
+	size_t scanned;
+};
+
+/*
+	SLAB
+*/
+struct csocket_slot {
+	// peer address (inline)
+	struct sockaddr_storage addr;
+	// keepalive state, buffers are kept across reuse
+	struct csocket_keepalive ka;
+	// message framing, buffer is kept across reuse
+	struct csocket_framer framer;
+	// counters of the client, cleared on reuse
+	csocket_stats_t stats;
+	// next free slot, -1 terminates the list
+	int next;
+};
+
+typedef struct csocket_slab {
+	struct csocket_slot *slots;
+	int capacity;
+	// free list head, -1 if exhausted
+	int free_head;
+} csocket_slab_t;
+
+/*
+	HISTOGRAM
+*/
+// log-linear: exact below 2*CSHIST_SUB, then CSHIST_SUB buckets per power of two (~3% error)
+#define CSHIST_SUB_BITS 5
+#define CSHIST_SUB (1<<CSHIST_SUB_BITS)
+// values above 2^50 go to the last bucket
+#define CSHIST_BUCKETS (2*CSHIST_SUB+45*CSHIST_SUB)
+
+typedef struct csocket_histogram {
+	unsigned long long counts[CSHIST_BUCKETS];
+	unsigned long long total;
+	unsigned long long sum;
+	unsigned long long max;
+} csocket_histogram_t;
+
+// handler phases, values in ns
+// accept to the CSACT_TYPE_CONN callback
+#define CSHIST_ACCEPT 0
+// readiness (poll) to the callback
+#define CSHIST_DISPATCH 1
+// duration of onActivity, onActivity2 and onMessage
+#define CSHIST_CALLBACK 2
+// csocket_multiServer iteration
+#define CSHIST_LOOP 3
+#define CSHIST_COUNT 4
+
+/*
+	METRICS
+*/
+// scrapes that do not send a complete request within this time (seconds) are dropped
+#define CSMET_TIMEOUT 2
+// largest metrics page
+#define CSMET_BUFLEN 16384
+
+typedef struct csocket_metrics {
+	// listener and the scrape being served (-1 if none)
+	int fd;
+	int conn;
+	// accept of the scrape (CSOCKET_CLOCK)
+	struct timespec conn_since;
+	// consecutive line breaks of the request, complete at 2
+	int request_state;
+	// events since csocket_setMetrics
+	unsigned long long accepted;
+	unsigned long long declined;
+	unsigned long long ka_timeouts;
+	// end of the last iteration or of the sleep in csocket_multiServerWait, largest gap from there to the next iteration since the last scrape (ns)
+	unsigned long long loop_last;
+	unsigned long long loop_gap;
+} csocket_metrics_t;
+
+/*
+	HANDOFF
+*/
+// both processes have to use the same version
+#define CSHOF_VERSION 1
+// longest keepalive message of a handed off client
+#define CSHOF_MSGLEN 1024
+
+// sent along with the descriptor (SCM_RIGHTS), followed by the address and the keepalive message
+struct csocket_handoff {
+	int version;
+	// peer address
+	int domain;
+	socklen_t addr_len;
+	time_t connection_time;
+	// keepalive settings, ka_enabled<0 if the client has no keepalive
+	int ka_enabled;
+	int ka_timeout;
+	int ka_mode;
+	int ka_msg_type;
+	size_t ka_msg_len;
+	socklen_t ka_buffer_len;
+	socklen_t ka_params_len;
+};
+
 
 typedef struct csocket_multiHandler {
 	// socket
 	csocket_t *src_socket;
 	// handler function
 	void (*onActivity)(struct csocket_multiHandler *, csocket_activity_t);
-	// client stash
+	// client stash, one stable activity per client (client_socket.fd>0 if used)
 	int maxClients;
-	struct csocket_clients *client_sockets;
+	csocket_activity_t *activities;
+	// client state, slot i belongs to activities[i]
+	struct csocket_slab slab;
+	// poll set, server socket and one entry per slot
+	struct pollfd *pfds;
+	// allocator for the handler, falls back to the global allocator
+	csocket_allocator_t allocator;
+	// framing for new clients and message handler, see csocket_setFraming
+	struct csocket_framer framing;
+	void (*onMessage)(struct csocket_multiHandler *, csocket_activity_t *, const char *, size_t);
+	// handler function v2, gets the stable activity of the client (preferred over onActivity)
+	void (*onActivity2)(struct csocket_multiHandler *, csocket_activity_t *);
+	// user data
+	void *user;
+	// latency histograms, CSHIST_COUNT phases or NULL, see csocket_setHistograms
+	csocket_histogram_t *hist;
+	// poll return and accept of the current iteration (ns)
+	unsigned long long hist_ready;
+	unsigned long long hist_accept;
+	// counters of disconnected clients, see csocket_getStats
+	csocket_stats_t stats;
+	// metrics listener or NULL, see csocket_setMetrics
+	csocket_metrics_t *metrics;
+	// channel polled for clients of other processes (>0 if set), see csocket_setHandoff
+	int handoff;
 } csocket_multiHandler_t;
 
+/*
+	PREFORK
+*/
+// every worker listens on its own socket (SO_REUSEPORT) instead of the shared listener
+#define CSPF_REUSEPORT 1
+// a crashed worker is restarted at most once per interval (seconds)
+#define CSPF_RESTART_INTERVAL 1
+
+struct csocket_worker {
+	// process, 0 if not running
+	int pid;
+	// last start (CSOCKET_CLOCK)
+	struct timespec started;
+	// waitpid status of the last exit, restart pending if crashed (signal or exit status other than 0)
+	int status;
+	int crashed;
+	unsigned long long restarts;
+};
+
+typedef struct csocket_prefork {
+	// bound listener of the parent
+	csocket_t *src_socket;
+	// CSPF_* flags
+	int flags;
+	// listen queue of per-worker sockets (CSPF_REUSEPORT), 0 uses SOMAXCONN
+	int backlog;
+	// runs the multiServer loop of worker index, the return value is its exit status
+	int (*worker)(csocket_t *src_socket, int index, void *user);
+	void *user;
+	int count;
+	struct csocket_worker *workers;
+	// csocket_prefork_stop was called, nothing is restarted
+	int stopping;
+	// the shared listener was blocking, csocket_freePrefork switches it back
+	int restore_block;
+} csocket_prefork_t;
+
+/*
+	POOL
+*/
+struct csocket_pool_entry {
+	// connected socket, handed out by csocket_pool_get (fd>0 if used)
+	csocket_t socket;
+	// destination (inline, used as socket.mode.addr)
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	// handed out
+	int busy;
+	// returned at (CSOCKET_CLOCK)
+	struct timespec idle_since;
+};
+
+typedef struct csocket_pool {
+	struct csocket_pool_entry *entries;
+	int capacity;
+	// connections per destination, 0 for no limit
+	int max_per_dest;
+	// idle connections are closed after idle_timeout seconds
+	int idle_timeout;
+	// socket type and protocol of new connections
+	int type;
+	int protocol;
+} csocket_pool_t;
+
 
 /*
 	SOCKET SETUP
@@ -237,15 +619,17 @@ int csocket_initServerSocket(int domain, int type, int protocol, void *addrc, in
 
 int csocket_initClientSocket(int domain, int type, int protocol, void *addrc, int port, csocket_t *src_socket, int specialAddr);
 
+static int _peerDomain(struct sockaddr *addr, socklen_t addr_len, socklen_t size);
+
 #pragma endregion
 /*
 	RECV/SEND
 */
 #pragma region RECV/SEND
 
-static int _hasRecvData(int fd);
+static int _hasRecvData(int fd, csocket_stats_t *stats);
 
-static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len);
+static int _hasRecvFromData(int fd, struct sockaddr *addr, socklen_t *addr_len, csocket_stats_t *stats);
 
 int csocket_hasRecvData(csocket_t *src_socket);
 
@@ -255,6 +639,20 @@ ssize_t csocket_recv(csocket_t *src_socket, void *buf, size_t len, int flags);
 
 ssize_t csocket_recvfrom(csocket_t *src_socket, csocket_addr_t *dst_addr, void *buf, size_t len, int flags);
 
+ssize_t csocket_recvDeadline(csocket_t *src_socket, void *buf, size_t len, int flags, const struct timespec *deadline);
+
+int csocket_deadline(struct timespec *deadline, const struct timespec *timeout);
+
+int csocket_setTimeout(csocket_t *src_socket, const struct timespec *timeout);
+
+static const struct timespec * _csTimeout(const struct timespec *timeout);
+
+static const struct timespec * _deadline(struct timespec *deadline, const struct timespec *timeout);
+
+static int _pollFd(int fd, short events, const struct timespec *deadline);
+
+static int _pollNow(int fd, short events);
+
 ssize_t csocket_send(csocket_t *src_socket, void *buf, size_t len, int flags);
 
 ssize_t csocket_sendto(csocket_t *src_socket, void *buf, size_t len, int flags);
@@ -273,18 +671,68 @@ static ssize_t _updateBuffer(struct csocket_keepalive *ka, int fd, int flags);
 
 static ssize_t _updateFromBuffer(struct csocket_keepalive *ka, int fd, int flags, struct sockaddr *addr, socklen_t *addr_len);
 
+static csocket_activity_t * _sockAct(csocket_t *src_socket, csocket_addr_t *dst_addr);
+
 static ssize_t _readBuffer(csocket_t *src_socket, void *buf, size_t len, int flags);
 
-static ssize_t _readBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags);
+static int _waitBuffer(csocket_activity_t *activity, const struct timespec *deadline, int from);
+
+static ssize_t _readBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline);
 
 static ssize_t _readFromBuffer(csocket_t *src_socket, csocket_addr_t *dst_addr, void *buf, size_t len, int flags);
 
-static ssize_t _readFromBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags);
+static ssize_t _readFromBufferA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline);
 
 static int _searchKeyKeepAlive(const char *query, size_t qlength, const char *msg, size_t *msg_offset, const char *buffer, socklen_t *buffer_offset, socklen_t buffer_usage, socklen_t *var_len);
 
 static int _findKeepAliveMsg(char *msg, size_t msg_len, char *buffer, socklen_t *buffer_usage, char *params, socklen_t *params_usage);
 
+static ssize_t _recvNb(int fd, void *buf, size_t len, int flags, csocket_stats_t *stats);
+
+static int _updateFrames(struct csocket_keepalive *ka, int fd);
+
+static ssize_t _readFrameA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline);
+
+static ssize_t _sendFrame(int fd, unsigned char type, const void *buf, size_t len, int flags, csocket_stats_t *stats);
+
+static int _kaBuffered(const struct csocket_keepalive *ka);
+
+static int _setKernelKeepAlive(int fd, int timeout);
+
+static void _updateKernelKeepAlive(struct csocket_keepalive *ka, int fd);
+
+#pragma endregion
+/*
+	SLAB
+*/
+#pragma region SLAB
+
+static int _slabInit(struct csocket_slab *slab, int capacity, const csocket_allocator_t *allocator);
+
+static int _slabAlloc(struct csocket_slab *slab);
+
+static void _slabRelease(struct csocket_slab *slab, int index);
+
+static void _slabFree(struct csocket_slab *slab, const csocket_allocator_t *allocator);
+
+#pragma endregion
+/*
+	ALLOCATOR
+*/
+#pragma region ALLOCATOR
+
+int csocket_setAllocator(csocket_multiHandler_t *handler, const csocket_allocator_t *allocator);
+
+static const csocket_allocator_t * _resolveAllocator(const csocket_allocator_t *allocator);
+
+static void * _csMalloc(const csocket_allocator_t *allocator, size_t size);
+
+static void * _csCalloc(const csocket_allocator_t *allocator, size_t nmemb, size_t size);
+
+static void * _csRealloc(const csocket_allocator_t *allocator, void *ptr, size_t size);
+
+static void _csFree(const csocket_allocator_t *allocator, void *ptr);
+
 #pragma endregion
 /*
 	ACTIVITY
@@ -303,6 +751,8 @@ int csocket_hasRecvFromDataA(csocket_activity_t *activity);
 
 ssize_t csocket_recvA(csocket_activity_t *activity, void *buf, size_t len, int flags);
 
+ssize_t csocket_recvDeadlineA(csocket_activity_t *activity, void *buf, size_t len, int flags, const struct timespec *deadline);
+
 ssize_t csocket_recvfromA(csocket_activity_t *activity, void *buf, size_t len, int flags);
 
 ssize_t csocket_sendA(csocket_activity_t *activity, void *buf, size_t len, int flags);
@@ -327,8 +777,12 @@ int csocket_keepalive_set(struct csocket_keepalive *ka, csocket_t *src_socket);
 
 int csocket_keepalive_unset(csocket_t *src_socket);
 
+int csocket_keepalive_setMode(int mode, struct csocket_keepalive *ka, csocket_t *src_socket);
+
 int csocket_keepalive_copy(struct csocket_keepalive **dst, const struct csocket_keepalive *src);
 
+static int _keepaliveCopy(struct csocket_keepalive *dst, const struct csocket_keepalive *src, const csocket_allocator_t *allocator);
+
 int csocket_isAlive(struct csocket_keepalive *ka);
 
 int csocket_keepAlive(csocket_t *src_socket);
@@ -351,8 +805,12 @@ void csocket_printKeepAlive(FILE *fp, csocket_keepalive_t *ka);
 
 int csocket_bindServer(csocket_t *src_socket);
 
+static void _unlinkStale(const struct sockaddr *addr, socklen_t addr_len, int type);
+
 int csocket_listen(csocket_t *src_socket, int maxQueue);
 
+int csocket_setFastOpen(csocket_t *src_socket, int qlen);
+
 	/*
 		ONE CLIENT AT A TIME
 	*/
@@ -365,10 +823,109 @@ int csocket_listen(csocket_t *src_socket, int maxQueue);
 	// handling all clients - should be called in a while(true)
 	int csocket_setUpMultiServer(csocket_t *src_socket, int maxClient, void (*onActivity)(csocket_multiHandler_t *, csocket_activity_t), csocket_multiHandler_t *handler);
 
+	int csocket_setUpMultiServer2(csocket_t *src_socket, int maxClient, void (*onActivity2)(csocket_multiHandler_t *, csocket_activity_t *), void *user, csocket_multiHandler_t *handler);
+
 	int csocket_multiServer(csocket_multiHandler_t *handler);
 
+	// waits up to timeout for an event, then runs one iteration
+	int csocket_multiServerWait(csocket_multiHandler_t *handler, const struct timespec *timeout);
+
+	// one timed iteration, polled is the result of a poll on handler->pfds that already ran or -1
+	static int _runMultiServer(csocket_multiHandler_t *handler, int polled);
+
+	static int _multiServer(csocket_multiHandler_t *handler, int polled);
+
+	static int _pollSet(csocket_multiHandler_t *handler);
+
+	static void _dispatchActivity(csocket_multiHandler_t *handler, csocket_activity_t *activity);
+
+	static void _dispatchMessage(csocket_multiHandler_t *handler, csocket_activity_t *activity, const char *msg, size_t len);
+
+	static int _acceptClient(csocket_multiHandler_t *handler, int server_fd);
+
+	static int _admitClient(csocket_multiHandler_t *handler, int slot, struct csocket_clients *client);
+
+	// outbound connection managed by the handler
+	int csocket_connectAsync(csocket_multiHandler_t *handler, const csocket_addr_t *dst, void *user);
+
+	static void _updateConnect(csocket_multiHandler_t *handler, int slot, short revents);
+
 int csocket_shutdownClient(csocket_multiHandler_t *handler, struct csocket_clients *client);
 
+	/*
+		FRAMING
+	*/
+	int csocket_setFraming(csocket_multiHandler_t *handler, struct csocket_clients *client, int type, size_t param, size_t max_len);
+
+	static int _readMessages(csocket_multiHandler_t *handler, csocket_activity_t *activity, struct csocket_framer *framer);
+
+	static void _freeFramer(struct csocket_framer *framer, const csocket_allocator_t *allocator);
+
+	/*
+		HISTOGRAMS
+	*/
+	int csocket_setHistograms(csocket_multiHandler_t *handler, int enable);
+
+	int csocket_getHistogram(const csocket_multiHandler_t *handler, int phase, csocket_histogram_t *snapshot);
+
+	void csocket_resetHistograms(csocket_multiHandler_t *handler);
+
+	static unsigned long long _histClock(void);
+
+	static unsigned long long _histBegin(csocket_multiHandler_t *handler, int phase, unsigned long long since);
+
+	static void _histEnd(csocket_multiHandler_t *handler, unsigned long long start);
+
+	/*
+		STATS
+	*/
+	int csocket_getStats(const csocket_multiHandler_t *handler, const struct csocket_clients *client, csocket_stats_t *stats);
+
+	static ssize_t _statRecv(csocket_stats_t *stats, ssize_t res, int flags);
+
+	static ssize_t _statSend(csocket_stats_t *stats, ssize_t res);
+
+	static void _statAdd(csocket_stats_t *dst, const csocket_stats_t *src);
+
+	static void _statBuffer(csocket_stats_t *stats, size_t usage);
+
+	/*
+		METRICS
+	*/
+	int csocket_setMetrics(csocket_multiHandler_t *handler, const csocket_addr_t *addr);
+
+	ssize_t csocket_formatMetrics(const csocket_multiHandler_t *handler, char *buf, size_t len);
+
+	static void _updateMetrics(csocket_multiHandler_t *handler, short listen_revents, short conn_revents);
+
+	static int _metricsAppend(char *buf, size_t len, size_t *offset, const char *fmt, ...);
+
+	static void _freeMetrics(csocket_multiHandler_t *handler);
+
+	/*
+		HANDOFF
+	*/
+	int csocket_handoffClient(csocket_multiHandler_t *handler, struct csocket_clients *client, int channel);
+
+	int csocket_adoptClient(csocket_multiHandler_t *handler, int channel);
+
+	int csocket_setHandoff(csocket_multiHandler_t *handler, int channel);
+
+	/*
+		PREFORK
+	*/
+	int csocket_prefork_create(csocket_t *src_socket, int workers, int flags, int (*worker)(csocket_t *, int, void *), void *user, csocket_prefork_t *prefork);
+
+	int csocket_prefork_supervise(csocket_prefork_t *prefork);
+
+	int csocket_prefork_stop(csocket_prefork_t *prefork, const struct timespec *timeout);
+
+	#ifndef _WIN32
+		static int _forkWorker(csocket_prefork_t *prefork, int index);
+
+		static int _reapWorker(struct csocket_worker *worker, int options);
+	#endif
+
 #pragma endregion
 /*
 	CLIENT
@@ -377,6 +934,30 @@ int csocket_shutdownClient(csocket_multiHandler_t *handler, struct csocket_clien
 
 int csocket_connectClient(csocket_t *src_socket, struct timeval *timeout);
 
+ssize_t csocket_connectSend(csocket_t *src_socket, const void *buf, size_t len, int flags, struct timeval *timeout);
+
+// delay between staggered connection attempts in ms (RFC 8305)
+#define CSOCKET_CONNECT_DELAY 250
+
+int csocket_connectMulti(const csocket_addr_t *addrs, int count, int type, int protocol, struct timeval *timeout, csocket_t *src_socket);
+
+static void _setNonBlock(int fd, int enable);
+
+	/*
+		POOL
+	*/
+	int csocket_pool_create(int capacity, int max_per_dest, int idle_timeout, int type, int protocol, csocket_pool_t *pool);
+
+	csocket_t * csocket_pool_get(csocket_pool_t *pool, const csocket_addr_t *dst, struct timeval *timeout);
+
+	int csocket_pool_put(csocket_pool_t *pool, csocket_t *src_socket, int reuse);
+
+	int csocket_pool_prune(csocket_pool_t *pool);
+
+	static int _poolAlive(int fd);
+
+	static void _poolClose(struct csocket_pool_entry *entry);
+
 #pragma endregion
 /*
 	UTIL
@@ -386,6 +967,38 @@ int csocket_connectClient(csocket_t *src_socket, struct timeval *timeout);
 const char * csocket_ntop(int domain, const void *addr, char *dst, socklen_t len);
 #define CSOCKET_NTOP(domain, addr, str, strlen) csocket_ntop(domain, addr, str, strlen)
 
+const char * csocket_ntopA(const csocket_addr_t *addr, char *dst, socklen_t len);
+
+#ifndef _WIN32
+	static const char * _ntopUnix(const void *addr, size_t size, char *dst, socklen_t len);
+#endif
+
+const char * csocket_strerror(int err);
+
+static void _csError(csocket_t *src_socket, int err);
+
+void csocket_now(struct timespec *now);
+
+static const struct timespec * _csNow(void);
+
+static time_t _csTime(void);
+
+static void _csClockBegin(void);
+
+static void _csClockEnd(void);
+
+static void _kaSignal(struct csocket_keepalive *ka);
+
+static int _kaWithin(const struct csocket_keepalive *ka, time_t seconds);
+
+void csocket_histogram_record(csocket_histogram_t *hist, unsigned long long value);
+
+unsigned long long csocket_histogram_percentile(const csocket_histogram_t *hist, double p);
+
+void csocket_histogram_merge(csocket_histogram_t *dst, const csocket_histogram_t *src);
+
+static int _histBucket(unsigned long long value);
+
 #pragma endregion
 /*
 	FREE
@@ -395,20 +1008,30 @@ const char * csocket_ntop(int domain, const void *addr, char *dst, socklen_t len
 // free
 void csocket_free(csocket_t *src_socket);
 
+// not for activities and clients of a multiHandler, their state belongs to the handler's slab
 void csocket_freeActivity(csocket_activity_t *activity);
 
 void csocket_freeMultiHandler(csocket_multiHandler_t *handler);
 
+// see csocket_freeActivity
 void csocket_freeClients(struct csocket_clients *client);
 
 void csocket_freeKeepalive(struct csocket_keepalive *ka);
 
+void csocket_freePool(csocket_pool_t *pool);
+
+void csocket_freePrefork(csocket_prefork_t *prefork);
+
+static void _freeKeepalive(struct csocket_keepalive *ka, const csocket_allocator_t *allocator);
+
 #pragma endregion
 
 
 // close connection
 void csocket_close(csocket_t *src_socket);
 
+static void _closeFd(int fd);
+
 // non callable funtions
 static void __attribute__((constructor)) csocket_constructor();
 static void __attribute__((destructor)) csocket_destructor();